@@ -0,0 +1,18 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform constants {
+    vec2 viewCenter;
+    uint textureIndex;
+};
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+void main() {
+    // The same for the whole draw, no nonuniformEXT needed
+    outColor = texture(textures[textureIndex], uv);
+}
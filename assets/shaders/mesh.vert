@@ -0,0 +1,26 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inUv;
+
+layout(location = 0) out vec2 uv;
+
+layout(push_constant) uniform constants {
+    vec2 viewCenter;
+    uint textureIndex;
+    float padding;
+    // Center and radius of the bounding sphere
+    vec4 bounds;
+};
+
+layout(binding = 1) uniform UBO {
+    mat4 persMat;
+};
+
+void main() {
+    // Fit to the quad, y up and z toward the camera, which looks down +x with
+    // z up. No depth buffer, overlapping triangles land in index order.
+    vec3 p = (inPosition - bounds.xyz) * (0.5 / max(bounds.w, 1e-6));
+    gl_Position = persMat * vec4(1.5 - p.z, viewCenter.x - p.x, viewCenter.y + p.y, 1.0);
+    uv = inUv;
+}
@@ -0,0 +1,14 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 uv;
+layout(location = 1) flat in uint textureIndex;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+void main() {
+    // Draws of one indirect call differ in texture
+    outColor = texture(textures[nonuniformEXT(textureIndex)], uv);
+}
@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inUv;
+layout(location = 2) in vec2 instPosition;
+layout(location = 3) in vec2 instScale;
+layout(location = 4) in vec4 instUvRect;
+
+layout(location = 0) out vec2 uv;
+
+layout(push_constant) uniform constants {
+    vec2 viewCenter;
+    uint textureIndex;
+};
+
+layout(binding = 1) uniform UBO {
+    mat4 persMat;
+};
+
+void main() {
+    gl_Position = persMat * vec4(1.0, inPosition * instScale + instPosition + viewCenter, 1.0);
+    // Same orientation as the quad, the rect spans the whole sprite
+    uv = instUvRect.xy + (0.5 - inPosition) * instUvRect.zw;
+}
@@ -1,12 +1,13 @@
 #version 450
 
 layout(location = 0) in vec2 inPosition;
-layout(location = 1) in vec3 inColor;
+layout(location = 1) in vec2 inUv;
 
 layout(location = 0) out vec2 uv;
 
 layout(push_constant) uniform constants {
     vec2 viewCenter;
+    uint textureIndex;
 };
 
 layout(binding = 1) uniform UBO {
@@ -15,5 +16,5 @@ layout(binding = 1) uniform UBO {
 
 void main() {
     gl_Position = persMat * vec4(1.0, inPosition + viewCenter, 1.0);
-    uv = vec2(inColor);
+    uv = inUv;
 }
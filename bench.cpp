@@ -0,0 +1,389 @@
+#include "BaseEngine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+
+struct Options
+{
+	uint64_t frames = 1000;
+	double seconds = 0.0;
+	uint64_t warmup = 30;
+	int width = 1280;
+	int height = 720;
+	bool windowed = false;
+	bool preferCpu = false;
+	bool validation = false;
+	bool mipmaps = true;
+	bool minified = false;
+	const char* textures = nullptr;
+	bool textureCache = true;
+	unsigned threads = 0;
+	uint64_t sprites = 0;
+	uint32_t objects = 0;
+	const char* json = nullptr;
+};
+
+struct StageStats
+{
+	double mean, p50, p95, p99;
+};
+
+void usage(const char* argv0)
+{
+	std::fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --frames N       frames to measure (default 1000)\n"
+		"  --seconds S      measure for S seconds instead of a frame count\n"
+		"  --warmup N       unmeasured frames before the run (default 30)\n"
+		"  --size WxH       render extent (default 1280x720)\n"
+		"  --windowed       present to a window instead of offscreen images\n"
+		"  --prefer-cpu     prefer a software device such as lavapipe\n"
+		"  --validation     enable validation layers\n"
+		"  --minified       draw the textured quad at 1/8 of the extent, compare with --no-mips\n"
+		"  --no-mips        load textures without mip chains\n"
+		"  --textures DIR   time loading every image in DIR before the run\n"
+		"  --no-texture-cache  decode every texture instead of using the on-disk cache\n"
+		"  --threads N      background worker threads (default one per core but one)\n"
+		"  --sprites N      animate N sprites over the quad, rebuilt every frame\n"
+		"  --objects N      add N static objects to the GPU culled scene, most of them out of view\n"
+		"  --json PATH      write results as JSON\n",
+		argv0);
+}
+
+bool parse(int argc, char* argv[], Options& opt)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(arg, "--frames") == 0 && hasValue) {
+			opt.frames = std::strtoull(argv[++i], nullptr, 10);
+		} else if (std::strcmp(arg, "--seconds") == 0 && hasValue) {
+			opt.seconds = std::strtod(argv[++i], nullptr);
+		} else if (std::strcmp(arg, "--warmup") == 0 && hasValue) {
+			opt.warmup = std::strtoull(argv[++i], nullptr, 10);
+		} else if (std::strcmp(arg, "--size") == 0 && hasValue) {
+			if (std::sscanf(argv[++i], "%dx%d", &opt.width, &opt.height) != 2
+				|| opt.width <= 0 || opt.height <= 0)
+				return false;
+		} else if (std::strcmp(arg, "--windowed") == 0) {
+			opt.windowed = true;
+		} else if (std::strcmp(arg, "--prefer-cpu") == 0) {
+			opt.preferCpu = true;
+		} else if (std::strcmp(arg, "--validation") == 0) {
+			opt.validation = true;
+		} else if (std::strcmp(arg, "--minified") == 0) {
+			opt.minified = true;
+		} else if (std::strcmp(arg, "--no-mips") == 0) {
+			opt.mipmaps = false;
+		} else if (std::strcmp(arg, "--textures") == 0 && hasValue) {
+			opt.textures = argv[++i];
+		} else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+			opt.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(arg, "--sprites") == 0 && hasValue) {
+			opt.sprites = std::strtoull(argv[++i], nullptr, 10);
+		} else if (std::strcmp(arg, "--objects") == 0 && hasValue) {
+			opt.objects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(arg, "--no-texture-cache") == 0) {
+			opt.textureCache = false;
+		} else if (std::strcmp(arg, "--json") == 0 && hasValue) {
+			opt.json = argv[++i];
+		} else {
+			return false;
+		}
+	}
+	return opt.frames > 0 || opt.seconds > 0.0;
+}
+
+// Nearest-rank percentiles in milliseconds
+StageStats summarize(std::vector<double>& samples)
+{
+	if (samples.empty())
+		return {};
+	std::sort(samples.begin(), samples.end());
+	const auto rank = [&](double p) {
+		const auto idx = static_cast<size_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+		return samples[idx];
+	};
+	double sum = 0.0;
+	for (const auto s : samples)
+		sum += s;
+	return { sum / static_cast<double>(samples.size()), rank(0.50), rank(0.95), rank(0.99) };
+}
+
+double toMs(std::chrono::nanoseconds ns)
+{
+	return std::chrono::duration<double, std::milli>(ns).count();
+}
+
+// A grid of objects well past the edges of the view, so most of them are culled
+void addObjects(VulkanPlayground::BaseEngine& engine, uint32_t count)
+{
+	auto& scene = *engine.scene();
+	const auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	const float cell = 6.0f / static_cast<float>(side);
+	for (uint32_t i = 0; i < count; i++) {
+		const glm::vec2 center {
+			-3.0f + cell * (static_cast<float>(i % side) + 0.5f),
+			-3.0f + cell * (static_cast<float>(i / side) + 0.5f)
+		};
+		scene.add(engine.quadMesh(), engine.mainTexture(), {
+			.position = center,
+			.scale = glm::vec2(0.8f * cell)
+		});
+	}
+}
+
+// A grid of sprites over the view, each circling its cell, alternating
+// between sampling the whole texture and a quarter of it
+void animateSprites(VulkanPlayground::BaseEngine& engine, uint64_t count, double seconds)
+{
+	auto& sprites = engine.sprites();
+	sprites.clear();
+	const auto texture = engine.mainTexture();
+	const auto side = static_cast<uint64_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	const float cell = 2.0f / static_cast<float>(side);
+	const auto t = static_cast<float>(seconds);
+	for (uint64_t i = 0; i < count; i++) {
+		const auto phase = t * 2.0f + static_cast<float>(i % 64) * 0.1f;
+		const glm::vec2 center {
+			-1.0f + cell * (static_cast<float>(i % side) + 0.5f),
+			-1.0f + cell * (static_cast<float>(i / side) + 0.5f)
+		};
+		sprites.add(texture, {
+			.position = center + 0.25f * cell * glm::vec2(std::cos(phase), std::sin(phase)),
+			.scale = glm::vec2(0.5f * cell),
+			.uvRect = i % 2 ? glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) : glm::vec4(0.0f, 0.0f, 0.5f, 0.5f)
+		});
+	}
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!parse(argc, argv, opt)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	VulkanPlayground::EngineConfig config;
+	config.headless = !opt.windowed;
+	config.validation = opt.validation;
+	// The quad covers a fixed part of the extent, shrinking the extent minifies the texture
+	if (opt.minified) {
+		opt.width = std::max(1, opt.width / 8);
+		opt.height = std::max(1, opt.height / 8);
+	}
+	config.extent = {opt.width, opt.height};
+	config.mipmaps = opt.mipmaps;
+	config.workerThreads = opt.threads;
+	if (!opt.textureCache)
+		config.textureCachePath.clear();
+	config.sceneObjects = std::max(config.sceneObjects, opt.objects);
+	// Room for every instance in each frame's slice of the arena
+	config.frameArenaSize = std::max<uint64_t>(config.frameArenaSize,
+		opt.sprites * sizeof(VulkanPlayground::SpriteInstance) + (1ull << 20));
+
+	VulkanPlayground::BaseEngine engine(config);
+	engine.ChooseGPU([&](const vk::PhysicalDevice& device) {
+		const auto type = device.getProperties().deviceType;
+		if (opt.preferCpu)
+			return type == vk::PhysicalDeviceType::eCpu ? 10 : 0;
+		return type == vk::PhysicalDeviceType::eDiscreteGpu ? 10 : 0;
+	});
+	const std::string deviceName = engine.physicalDevice().getProperties().deviceName;
+
+	if (opt.objects > 0) {
+		if (!engine.scene()) {
+			spdlog::error("The device has no GPU scene for --objects");
+			return 1;
+		}
+		addObjects(engine, opt.objects);
+		while (engine.scene()->pending() > 0)
+			engine.renderFrame();
+	}
+
+	// Measure with the real texture bound rather than the placeholder
+	while (engine.textures().pending() > 0)
+		engine.renderFrame();
+	for (uint64_t i = 0; i < opt.warmup; i++) {
+		if (opt.sprites > 0)
+			animateSprites(engine, opt.sprites, 0.0);
+		engine.renderFrame();
+	}
+
+	using clock = std::chrono::steady_clock;
+	// Frames keep rendering while the textures stream in, the slowest one shows any hitch
+	double textureSeconds = 0.0, textureWorstFrameMs = 0.0;
+	size_t textureCount = 0;
+	if (opt.textures) {
+		std::vector<std::string> paths;
+		for (const auto& entry : std::filesystem::directory_iterator(opt.textures)) {
+			auto ext = entry.path().extension().string();
+			std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+			if (entry.is_regular_file() && (ext == ".jpg" || ext == ".jpeg" || ext == ".png"))
+				paths.push_back(entry.path().string());
+		}
+		textureCount = paths.size();
+
+		const auto loadStart = clock::now();
+		engine.textures().load(paths);
+		auto frameStart = loadStart;
+		while (engine.textures().pending() > 0) {
+			engine.renderFrame();
+			const auto now = clock::now();
+			textureWorstFrameMs = std::max(textureWorstFrameMs, toMs(now - frameStart));
+			frameStart = now;
+		}
+		textureSeconds = std::chrono::duration<double>(clock::now() - loadStart).count();
+		spdlog::info("Loaded {} textures in {:.3f}s on {} threads, slowest frame meanwhile {:.3f} ms",
+			textureCount, textureSeconds, engine.threadPool().size(), textureWorstFrameMs);
+	}
+	const auto cacheStats = engine.textureCache()
+		? engine.textureCache()->stats() : VulkanPlayground::TextureCache::Stats {};
+
+	constexpr std::array stageNames { "acquire", "record", "submit", "present" };
+	std::array<std::vector<double>, stageNames.size()> samples;
+	for (auto& s : samples)
+		s.reserve(opt.seconds > 0.0 ? 4096 : opt.frames);
+
+	const auto deadline = std::chrono::duration<double>(opt.seconds);
+	const auto start = clock::now();
+	// Keyed by GPU profiler region, lagging the CPU samples by the frames in flight
+	std::map<std::string, std::vector<double>> gpuSamples;
+	uint64_t frames = 0, rebuilds = 0;
+	// A swapchain that stays out of date or minimized would never finish the run
+	constexpr uint64_t maxDroppedInARow = 1000;
+	uint64_t droppedInARow = 0;
+	std::vector<double> spriteSamples;
+	while (opt.seconds > 0.0 ? clock::now() - start < deadline : frames < opt.frames) {
+		if (opt.sprites > 0) {
+			const auto animateStart = clock::now();
+			animateSprites(engine, opt.sprites, std::chrono::duration<double>(animateStart - start).count());
+			spriteSamples.push_back(toMs(clock::now() - animateStart));
+		}
+		if (engine.renderFrame()) {
+			// The frame was dropped, its timings are not meaningful
+			rebuilds++;
+			if (++droppedInARow >= maxDroppedInARow) {
+				spdlog::error("{} frames in a row were dropped, giving up after {} frames", droppedInARow, frames);
+				return 1;
+			}
+			continue;
+		}
+		droppedInARow = 0;
+		const auto& t = engine.frameTimings();
+		samples[0].push_back(toMs(t.acquire));
+		samples[1].push_back(toMs(t.record));
+		samples[2].push_back(toMs(t.submit));
+		samples[3].push_back(toMs(t.present));
+		for (const auto& region : engine.gpuProfiler().results())
+			gpuSamples[region.name].push_back(region.ms);
+		frames++;
+	}
+	const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	const double fps = static_cast<double>(frames) / elapsed;
+
+	std::array<StageStats, stageNames.size()> stats;
+	for (size_t i = 0; i < stageNames.size(); i++)
+		stats[i] = summarize(samples[i]);
+	std::map<std::string, StageStats> gpuStats;
+	for (auto& [name, s] : gpuSamples)
+		gpuStats[name] = summarize(s);
+	const auto spriteStats = summarize(spriteSamples);
+	const auto sceneStats = engine.scene() ? engine.scene()->stats() : VulkanPlayground::GpuScene::Stats {};
+	const auto spriteBatches = engine.sprites().batches();
+
+	spdlog::info("{}: {} frames at {}x{} in {:.3f}s, {:.1f} frames/s, {} presenter rebuilds",
+		deviceName, frames, opt.width, opt.height, elapsed, fps, rebuilds);
+	for (size_t i = 0; i < stageNames.size(); i++) {
+		const auto& s = stats[i];
+		spdlog::info("\t{:<8} mean {:.4f} ms  p50 {:.4f} ms  p95 {:.4f} ms  p99 {:.4f} ms",
+			stageNames[i], s.mean, s.p50, s.p95, s.p99);
+	}
+	for (const auto& [name, s] : gpuStats) {
+		spdlog::info("\tgpu {:<8} mean {:.4f} ms  p50 {:.4f} ms  p95 {:.4f} ms  p99 {:.4f} ms",
+			name, s.mean, s.p50, s.p95, s.p99);
+	}
+	if (opt.objects > 0) {
+		spdlog::info("\t{} scene objects submitted, {} drawn after culling on the GPU",
+			sceneStats.submitted, sceneStats.surviving);
+	}
+	if (opt.sprites > 0) {
+		spdlog::info("\t{} sprites in {} draws, animating them mean {:.4f} ms  p95 {:.4f} ms",
+			opt.sprites, spriteBatches, spriteStats.mean, spriteStats.p95);
+	}
+
+	if (opt.json) {
+		const auto file = std::fopen(opt.json, "w");
+		if (!file) {
+			spdlog::error("Failed to open file: {}", opt.json);
+			return 1;
+		}
+		std::string escaped;
+		for (const auto c : deviceName) {
+			if (c == '"' || c == '\\')
+				escaped.push_back('\\');
+			escaped.push_back(c);
+		}
+		std::fprintf(file,
+			"{\n"
+			"  \"device\": \"%s\",\n"
+			"  \"headless\": %s,\n"
+			"  \"mipmaps\": %s,\n"
+			"  \"width\": %d,\n"
+			"  \"height\": %d,\n"
+			"  \"frames\": %llu,\n"
+			"  \"seconds\": %.6f,\n"
+			"  \"fps\": %.3f,\n"
+			"  \"rebuilds\": %llu,\n"
+			"  \"textures\": { \"count\": %zu, \"seconds\": %.6f, \"worst_frame_ms\": %.6f },\n"
+			"  \"texture_cache\": { \"hits\": %llu, \"misses\": %llu, \"evictions\": %llu },\n"
+			"  \"sprites\": { \"count\": %llu, \"draws\": %zu, \"animate_ms\": %.6f },\n"
+			"  \"scene\": { \"submitted\": %u, \"surviving\": %u },\n"
+			"  \"stages_ms\": {\n",
+			escaped.c_str(), config.headless ? "true" : "false", config.mipmaps ? "true" : "false",
+			opt.width, opt.height,
+			static_cast<unsigned long long>(frames), elapsed, fps,
+			static_cast<unsigned long long>(rebuilds),
+			textureCount, textureSeconds, textureWorstFrameMs,
+			static_cast<unsigned long long>(cacheStats.hits), static_cast<unsigned long long>(cacheStats.misses),
+			static_cast<unsigned long long>(cacheStats.evictions),
+			static_cast<unsigned long long>(opt.sprites), spriteBatches, spriteStats.mean,
+			sceneStats.submitted, sceneStats.surviving);
+		for (size_t i = 0; i < stageNames.size(); i++) {
+			const auto& s = stats[i];
+			std::fprintf(file,
+				"    \"%s\": { \"mean\": %.6f, \"p50\": %.6f, \"p95\": %.6f, \"p99\": %.6f }%s\n",
+				stageNames[i], s.mean, s.p50, s.p95, s.p99,
+				i + 1 < stageNames.size() ? "," : "");
+		}
+		std::fprintf(file, "  },\n  \"gpu_ms\": {\n");
+		size_t n = 0;
+		for (const auto& [name, s] : gpuStats) {
+			std::fprintf(file,
+				"    \"%s\": { \"mean\": %.6f, \"p50\": %.6f, \"p95\": %.6f, \"p99\": %.6f }%s\n",
+				name.c_str(), s.mean, s.p50, s.p95, s.p99,
+				++n < gpuStats.size() ? "," : "");
+		}
+		std::fprintf(file, "  }\n}\n");
+		std::fclose(file);
+	}
+	return 0;
+}
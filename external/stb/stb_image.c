@@ -426,6 +426,16 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+// Decode into caller memory, such as a mapped upload buffer, instead of a new
+// allocation: w x h pixels of desired_channels (1-4) each, rows out_stride
+// bytes apart. Returns 0 when the image is not w x h or fails to decode.
+// JPEGs are color converted straight into out, other formats are decoded as
+// usual and then copied.
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *out, size_t out_stride, int w, int h, int desired_channels);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into           (char const *filename, stbi_uc *out, size_t out_stride, int w, int h, int desired_channels);
+#endif
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
 #endif
@@ -521,6 +531,13 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// JPEGs are decoded with AVX2 kernels on CPUs that have it when built with
+// STBI_AVX2 and stb_image_avx2.c, bit-identical to the SSE2 ones. Pass 0 to
+// force the SSE2 or generic kernels, to compare the two.
+STBIDEF void stbi_set_jpeg_avx2(int flag_true_if_should_use);
+// Whether JPEGs decoded from now on use the AVX2 kernels
+STBIDEF int  stbi_jpeg_avx2_active(void);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -769,6 +786,34 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 JPEG kernels, in stb_image_avx2.c so only that file needs AVX2 enabled
+#if defined(STBI_AVX2) && (!defined(STBI_SSE2) || defined(STBI_NO_JPEG))
+#undef STBI_AVX2
+#endif
+
+#ifdef STBI_AVX2
+#include "stb_image_avx2.h"
+#ifdef _MSC_VER
+#include <immintrin.h> // _xgetbv
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info, 1);
+   // AVX and OSXSAVE, then that the OS saves the ymm registers
+   if ((info[2] & (3 << 27)) != (3 << 27) || (_xgetbv(0) & 6) != 6)
+      return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] >> 5) & 1;
+}
+#else
+static int stbi__avx2_available(void)
+{
+   // also checks that the OS saves the ymm registers
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1089,6 +1134,22 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
+static int stbi__jpeg_avx2_global = 1;
+
+STBIDEF void stbi_set_jpeg_avx2(int flag_true_if_should_use)
+{
+   stbi__jpeg_avx2_global = flag_true_if_should_use;
+}
+
+STBIDEF int stbi_jpeg_avx2_active(void)
+{
+#ifdef STBI_AVX2
+   return stbi__jpeg_avx2_global && stbi__avx2_available();
+#else
+   return 0;
+#endif
+}
+
 static int stbi__vertically_flip_on_load_global = 0;
 
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
@@ -1972,6 +2033,11 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+// caller memory the image is converted into, NULL to allocate it
+   stbi_uc *out;
+   size_t out_stride;
+   int out_w, out_h;
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
@@ -3776,6 +3842,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi_jpeg_avx2_active()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3831,11 +3905,17 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // accessing uninitialized coutput[0] later
    if (decode_n <= 0) { stbi__cleanup_jpeg(z); return NULL; }
 
+   if (z->out && ((int) z->s->img_x != z->out_w || (int) z->s->img_y != z->out_h)) {
+      stbi__cleanup_jpeg(z);
+      return stbi__errpuc("size mismatch", "Image is not the size decoded into");
+   }
+
    // resample and color-convert
    {
       int k;
       unsigned int i,j;
       stbi_uc *output;
+      size_t stride;
       stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
 
       stbi__resample res_comp[4];
@@ -3863,12 +3943,18 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       }
 
       // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      if (z->out) {
+         output = z->out;
+         stride = z->out_stride;
+      } else {
+         output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+         if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         stride = (size_t) n * z->s->img_x;
+      }
 
       // now go ahead and resample
       for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
+         stbi_uc *out = output + stride * j;
          for (k=0; k < decode_n; ++k) {
             stbi__resample *r = &res_comp[k];
             int y_bot = r->ystep >= (r->vs >> 1);
@@ -3976,6 +4062,7 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    if (!j) return stbi__errpuc("outofmem", "Out of memory");
    STBI_NOTUSED(ri);
    j->s = s;
+   j->out = NULL;
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
@@ -4019,6 +4106,62 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 }
 #endif
 
+static int stbi__load_into_main(stbi__context *s, stbi_uc *out, size_t out_stride, int w, int h, int req_comp)
+{
+   int x, y, comp, row;
+   stbi_uc *data;
+   if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+
+#ifndef STBI_NO_JPEG
+   // flipped rows go through the copy below
+   if (!stbi__vertically_flip_on_load && stbi__jpeg_test(s)) {
+      stbi__jpeg *j = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+      if (!j) return stbi__err("outofmem", "Out of memory");
+      j->s = s;
+      j->out = out;
+      j->out_stride = out_stride;
+      j->out_w = w;
+      j->out_h = h;
+      stbi__setup_jpeg(j);
+      data = load_jpeg_image(j, &x, &y, &comp, req_comp);
+      STBI_FREE(j);
+      return data != NULL;
+   }
+#endif
+
+   data = stbi__load_and_postprocess_8bit(s, &x, &y, &comp, req_comp);
+   if (!data) return 0;
+   if (x != w || y != h) {
+      STBI_FREE(data);
+      return stbi__err("size mismatch", "Image is not the size decoded into");
+   }
+   for (row = 0; row < h; ++row)
+      memcpy(out + out_stride * row, data + (size_t) req_comp * w * row, (size_t) req_comp * w);
+   STBI_FREE(data);
+   return 1;
+}
+
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *out, size_t out_stride, int w, int h, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into_main(&s, out, out_stride, w, h, req_comp);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into(char const *filename, stbi_uc *out, size_t out_stride, int w, int h, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi__context s;
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = stbi__load_into_main(&s, out, out_stride, w, h, req_comp);
+   fclose(f);
+   return result;
+}
+#endif
+
 // public domain zlib decode    v0.2  Sean Barrett 2006-11-18
 //    simple implementation
 //      - all input must be provided in an upfront buffer
@@ -426,6 +426,16 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+// Decode into caller memory, such as a mapped upload buffer, instead of a new
+// allocation: w x h pixels of desired_channels (1-4) each, rows out_stride
+// bytes apart. Returns 0 when the image is not w x h or fails to decode.
+// JPEGs are color converted straight into out, other formats are decoded as
+// usual and then copied.
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *out, size_t out_stride, int w, int h, int desired_channels);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into           (char const *filename, stbi_uc *out, size_t out_stride, int w, int h, int desired_channels);
+#endif
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
 #endif
@@ -521,6 +531,13 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// JPEGs are decoded with AVX2 kernels on CPUs that have it when built with
+// STBI_AVX2 and stb_image_avx2.c, bit-identical to the SSE2 ones. Pass 0 to
+// force the SSE2 or generic kernels, to compare the two.
+STBIDEF void stbi_set_jpeg_avx2(int flag_true_if_should_use);
+// Whether JPEGs decoded from now on use the AVX2 kernels
+STBIDEF int  stbi_jpeg_avx2_active(void);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -0,0 +1,22 @@
+/* AVX2 JPEG kernels for stb_image.c, built from stb_image_avx2.c with AVX2
+   enabled and only called after the CPU has been checked for it.
+   Each is a drop-in replacement for the SSE2 kernel of the same shape and
+   produces bit-identical output. */
+#ifndef STBI_INCLUDE_STB_IMAGE_AVX2_H
+#define STBI_INCLUDE_STB_IMAGE_AVX2_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void stbi__idct_avx2(unsigned char *out, int out_stride, short data[64]);
+void stbi__YCbCr_to_RGB_avx2(unsigned char *out, const unsigned char *y, const unsigned char *pcb,
+                             const unsigned char *pcr, int count, int step);
+unsigned char *stbi__resample_row_hv_2_avx2(unsigned char *out, unsigned char *in_near, unsigned char *in_far,
+                                            int w, int hs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STBI_INCLUDE_STB_IMAGE_AVX2_H
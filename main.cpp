@@ -1,10 +1,37 @@
 #include "BaseEngine.hpp"
 
+#include <cstdlib>
+#include <cstring>
+
 #include <spdlog/spdlog.h>
 
-int main()
+int main(int argc, char* argv[])
 {
-	VulkanPlayground::BaseEngine baseEngine;
+	VulkanPlayground::EngineConfig config;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--headless") == 0) {
+			config.headless = true;
+		} else if (std::strcmp(argv[i], "--no-validation") == 0) {
+			config.validation = false;
+		} else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			config.maxFrames = std::strtoull(argv[++i], nullptr, 10);
+		} else if (std::strcmp(argv[i], "--vsync") == 0) {
+			config.pacing = VulkanPlayground::PacingPolicy::VSync;
+		} else if (std::strcmp(argv[i], "--uncapped") == 0) {
+			config.pacing = VulkanPlayground::PacingPolicy::Uncapped;
+		} else if (std::strcmp(argv[i], "--hot-reload") == 0) {
+			config.shaderHotReload = true;
+		} else if (std::strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+			config.meshPath = argv[++i];
+		} else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			config.pacing = VulkanPlayground::PacingPolicy::Fixed;
+			config.targetFps = std::strtod(argv[++i], nullptr);
+		} else {
+			spdlog::warn("Ignoring unknown argument {}", argv[i]);
+		}
+	}
+
+	VulkanPlayground::BaseEngine baseEngine(config);
 
 	baseEngine.ChooseGPU([](const vk::PhysicalDevice& device) {
 		int score = 0;
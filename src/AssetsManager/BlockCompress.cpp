@@ -0,0 +1,264 @@
+//
+// Created by ocean on 3/27/22.
+//
+
+#include "BlockCompress.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace VulkanPlayground::BlockCompress
+{
+
+namespace {
+
+using Block = std::array<std::array<float, 4>, 16>;
+
+void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block& block)
+{
+	for (uint32_t y = 0; y < 4; y++) {
+		const auto sy = std::min(by * 4 + y, height - 1);
+		for (uint32_t x = 0; x < 4; x++) {
+			const auto sx = std::min(bx * 4 + x, width - 1);
+			const auto src = rgba + (size_t {sy} * width + sx) * 4;
+			for (uint32_t c = 0; c < 4; c++)
+				block[y * 4 + x][c] = src[c];
+		}
+	}
+}
+
+// Endpoints of the block along its principal axis, over the first channels channels
+template<uint32_t channels>
+void principalEndpoints(const Block& block, std::array<float, 4>& lo, std::array<float, 4>& hi)
+{
+	std::array<float, 4> mean {};
+	for (const auto& p : block)
+		for (uint32_t c = 0; c < channels; c++)
+			mean[c] += p[c] / 16.0f;
+
+	std::array<std::array<float, 4>, 4> cov {};
+	for (const auto& p : block) {
+		for (uint32_t i = 0; i < channels; i++)
+			for (uint32_t j = 0; j < channels; j++)
+				cov[i][j] += (p[i] - mean[i]) * (p[j] - mean[j]);
+	}
+
+	// Power iteration from the diagonal of the covariance converges in a few steps
+	std::array<float, 4> axis {};
+	for (uint32_t c = 0; c < channels; c++)
+		axis[c] = cov[c][c];
+	for (int iter = 0; iter < 8; iter++) {
+		std::array<float, 4> next {};
+		for (uint32_t i = 0; i < channels; i++)
+			for (uint32_t j = 0; j < channels; j++)
+				next[i] += cov[i][j] * axis[j];
+		float len = 0.0f;
+		for (uint32_t c = 0; c < channels; c++)
+			len = std::max(len, std::abs(next[c]));
+		if (len == 0.0f)
+			break;
+		for (uint32_t c = 0; c < channels; c++)
+			axis[c] = next[c] / len;
+	}
+	float norm = 0.0f;
+	for (uint32_t c = 0; c < channels; c++)
+		norm += axis[c] * axis[c];
+
+	float tmin = 0.0f, tmax = 0.0f;
+	if (norm > 0.0f) {
+		tmin = std::numeric_limits<float>::max();
+		tmax = std::numeric_limits<float>::lowest();
+		for (const auto& p : block) {
+			float t = 0.0f;
+			for (uint32_t c = 0; c < channels; c++)
+				t += (p[c] - mean[c]) * axis[c];
+			t /= norm;
+			tmin = std::min(tmin, t);
+			tmax = std::max(tmax, t);
+		}
+	}
+	for (uint32_t c = 0; c < channels; c++) {
+		lo[c] = std::clamp(mean[c] + axis[c] * tmin, 0.0f, 255.0f);
+		hi[c] = std::clamp(mean[c] + axis[c] * tmax, 0.0f, 255.0f);
+	}
+}
+
+template<uint32_t channels, size_t N>
+void nearestIndices(const Block& block, const std::array<std::array<int, 4>, N>& palette, std::array<uint8_t, 16>& indices)
+{
+	for (uint32_t i = 0; i < 16; i++) {
+		int best = INT32_MAX;
+		for (uint32_t k = 0; k < N; k++) {
+			int err = 0;
+			for (uint32_t c = 0; c < channels; c++) {
+				const int d = static_cast<int>(block[i][c]) - palette[k][c];
+				err += d * d;
+			}
+			if (err < best) {
+				best = err;
+				indices[i] = static_cast<uint8_t>(k);
+			}
+		}
+	}
+}
+
+uint16_t packRgb565(const std::array<float, 4>& c)
+{
+	const auto r = static_cast<uint16_t>(std::lround(c[0] * 31.0f / 255.0f));
+	const auto g = static_cast<uint16_t>(std::lround(c[1] * 63.0f / 255.0f));
+	const auto b = static_cast<uint16_t>(std::lround(c[2] * 31.0f / 255.0f));
+	return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+std::array<int, 4> unpackRgb565(uint16_t v)
+{
+	const int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+	return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255};
+}
+
+void encodeBc1Block(const Block& block, uint8_t* out)
+{
+	std::array<float, 4> lo {}, hi {};
+	principalEndpoints<3>(block, lo, hi);
+
+	auto c0 = packRgb565(hi);
+	auto c1 = packRgb565(lo);
+	std::array<uint8_t, 16> indices {};
+	if (c0 != c1) {
+		// Four color mode needs c0 > c1
+		if (c0 < c1)
+			std::swap(c0, c1);
+		const auto p0 = unpackRgb565(c0);
+		const auto p1 = unpackRgb565(c1);
+		std::array<std::array<int, 4>, 4> palette {p0, p1};
+		for (uint32_t c = 0; c < 3; c++) {
+			palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+			palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+		}
+		nearestIndices<3>(block, palette, indices);
+	}
+
+	uint32_t bits = 0;
+	for (uint32_t i = 0; i < 16; i++)
+		bits |= uint32_t {indices[i]} << (i * 2);
+	std::memcpy(out, &c0, 2);
+	std::memcpy(out + 2, &c1, 2);
+	std::memcpy(out + 4, &bits, 4);
+}
+
+class BitWriter
+{
+public:
+	explicit BitWriter(uint8_t* out) : out_(out) { std::memset(out_, 0, 16); }
+
+	void put(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, pos_++)
+			out_[pos_ / 8] |= static_cast<uint8_t>((value >> i & 1) << (pos_ % 8));
+	}
+
+private:
+	uint8_t* out_;
+	uint32_t pos_ = 0;
+};
+
+constexpr std::array<int, 16> bc7Weights4 = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// 7 bit endpoint plus its p-bit, picking the p-bit that lands closest
+void quantizeBc7Endpoint(const std::array<float, 4>& e, std::array<int, 4>& q, int& pbit)
+{
+	float bestErr = std::numeric_limits<float>::max();
+	for (int p = 0; p < 2; p++) {
+		std::array<int, 4> candidate {};
+		float err = 0.0f;
+		for (uint32_t c = 0; c < 4; c++) {
+			candidate[c] = std::clamp(static_cast<int>(std::lround((e[c] - p) / 2.0f)), 0, 127);
+			const float d = e[c] - static_cast<float>(candidate[c] << 1 | p);
+			err += d * d;
+		}
+		if (err < bestErr) {
+			bestErr = err;
+			q = candidate;
+			pbit = p;
+		}
+	}
+}
+
+void encodeBc7Block(const Block& block, uint8_t* out)
+{
+	std::array<float, 4> lo {}, hi {};
+	principalEndpoints<4>(block, lo, hi);
+
+	std::array<std::array<int, 4>, 2> q {};
+	std::array<int, 2> p {};
+	quantizeBc7Endpoint(lo, q[0], p[0]);
+	quantizeBc7Endpoint(hi, q[1], p[1]);
+
+	std::array<std::array<int, 4>, 16> palette {};
+	for (uint32_t k = 0; k < 16; k++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			const int e0 = q[0][c] << 1 | p[0];
+			const int e1 = q[1][c] << 1 | p[1];
+			palette[k][c] = ((64 - bc7Weights4[k]) * e0 + bc7Weights4[k] * e1 + 32) >> 6;
+		}
+	}
+	std::array<uint8_t, 16> indices {};
+	nearestIndices<4>(block, palette, indices);
+
+	// The first index is stored without its top bit, swap the endpoints to clear it
+	if (indices[0] & 8) {
+		std::swap(q[0], q[1]);
+		std::swap(p[0], p[1]);
+		for (auto& i : indices)
+			i = static_cast<uint8_t>(15 - i);
+	}
+
+	BitWriter bits(out);
+	bits.put(1u << 6, 7);
+	for (uint32_t c = 0; c < 4; c++) {
+		bits.put(static_cast<uint32_t>(q[0][c]), 7);
+		bits.put(static_cast<uint32_t>(q[1][c]), 7);
+	}
+	bits.put(static_cast<uint32_t>(p[0]), 1);
+	bits.put(static_cast<uint32_t>(p[1]), 1);
+	bits.put(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+		bits.put(indices[i], 4);
+}
+
+template<typename F>
+void encodeBlocks(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out, uint32_t blockBytes, F&& encode)
+{
+	const uint32_t bw = (width + 3) / 4, bh = (height + 3) / 4;
+	Block block;
+	for (uint32_t by = 0; by < bh; by++) {
+		for (uint32_t bx = 0; bx < bw; bx++) {
+			loadBlock(rgba, width, height, bx, by, block);
+			encode(block, out);
+			out += blockBytes;
+		}
+	}
+}
+
+}
+
+size_t encodedBytes(uint32_t width, uint32_t height, uint32_t blockBytes)
+{
+	return size_t {(width + 3) / 4} * ((height + 3) / 4) * blockBytes;
+}
+
+void encodeBc1(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out)
+{
+	encodeBlocks(rgba, width, height, out, 8, encodeBc1Block);
+}
+
+void encodeBc7(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out)
+{
+	encodeBlocks(rgba, width, height, out, 16, encodeBc7Block);
+}
+
+}
@@ -0,0 +1,33 @@
+//
+// Created by ocean on 3/27/22.
+//
+
+#ifndef BLOCKCOMPRESS_HPP
+#define BLOCKCOMPRESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanPlayground
+{
+
+/// Encoders from tightly packed RGBA8 to 4x4 block compressed formats.
+/// Blocks are written row by row. Partial blocks along the right and bottom
+/// edge repeat the last column or row. Values are encoded as they are, so
+/// sRGB input gives an sRGB block format.
+namespace BlockCompress
+{
+
+/// Bytes needed for a level of width x height with blocks of blockBytes
+size_t encodedBytes(uint32_t width, uint32_t height, uint32_t blockBytes);
+
+/// BC1 in four color mode, 8 bytes per block, alpha is dropped
+void encodeBc1(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out);
+/// BC7 mode 6 only: a single RGBA subset with 4 bit indices, 16 bytes per block
+void encodeBc7(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out);
+
+}
+
+}
+
+#endif //BLOCKCOMPRESS_HPP
@@ -0,0 +1,146 @@
+//
+// Created by ocean on 3/13/22.
+//
+
+#include "GeometryStore.hpp"
+
+#include <array>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+void createDeviceBuffer(VmaAllocator allocator, vk::DeviceSize size, vk::BufferUsageFlags usage,
+	vk::Buffer& buffer, VmaAllocation& alloc)
+{
+	const auto bufferCreate = (VkBufferCreateInfo)vk::BufferCreateInfo {
+		{},
+		size,
+		usage | vk::BufferUsageFlagBits::eTransferDst,
+		vk::SharingMode::eExclusive
+	};
+	const VmaAllocationCreateInfo allocCreate = {
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+		.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	};
+
+	VkBuffer created;
+	const auto result = vmaCreateBuffer(allocator, &bufferCreate, &allocCreate, &created, &alloc, nullptr);
+	if (result != VK_SUCCESS) {
+		spdlog::error("Falied to allocate buffer");
+		std::terminate();
+	}
+	buffer = created;
+}
+
+}
+
+GeometryStore::GeometryStore(VmaAllocator allocator, StagingRing& staging,
+	uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshVertexCapacity)
+	: allocator_(allocator), staging_(staging),
+	vertexRanges_(vertexCapacity), meshVertexRanges_(meshVertexCapacity), indexRanges_(indexCapacity)
+{
+	createDeviceBuffer(allocator_, sizeof(Vertex) * vertexCapacity,
+		vk::BufferUsageFlagBits::eVertexBuffer, vertexBuffer_, vertexAlloc_);
+	createDeviceBuffer(allocator_, sizeof(MeshVertex) * meshVertexCapacity,
+		vk::BufferUsageFlagBits::eVertexBuffer, meshVertexBuffer_, meshVertexAlloc_);
+	createDeviceBuffer(allocator_, sizeof(uint32_t) * indexCapacity,
+		vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer_, indexAlloc_);
+}
+
+GeometryStore::~GeometryStore()
+{
+	vmaDestroyBuffer(allocator_, (VkBuffer)indexBuffer_, indexAlloc_);
+	vmaDestroyBuffer(allocator_, (VkBuffer)meshVertexBuffer_, meshVertexAlloc_);
+	vmaDestroyBuffer(allocator_, (VkBuffer)vertexBuffer_, vertexAlloc_);
+}
+
+MeshHandle GeometryStore::add(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	return add(VertexStream::Quad, std::as_bytes(vertices), sizeof(Vertex), indices);
+}
+
+MeshHandle GeometryStore::add(const MeshFile& mesh)
+{
+	const auto& contents = mesh.contents();
+	return add(VertexStream::Mesh, std::as_bytes(contents.vertices), sizeof(MeshVertex), contents.indices);
+}
+
+MeshHandle GeometryStore::add(VertexStream stream, std::span<const std::byte> vertices, size_t stride,
+	std::span<const uint32_t> indices)
+{
+	const auto vertexCount = static_cast<uint32_t>(vertices.size() / stride);
+	auto& vertexRanges = stream == VertexStream::Mesh ? meshVertexRanges_ : vertexRanges_;
+	const auto firstVertex = vertexRanges.allocate(vertexCount);
+	if (!firstVertex) {
+		spdlog::warn("Geometry store out of vertex space for {} vertices", vertexCount);
+		return {};
+	}
+	const auto firstIndex = indexRanges_.allocate(indices.size());
+	if (!firstIndex) {
+		vertexRanges.free(*firstVertex, vertexCount);
+		spdlog::warn("Geometry store out of index space for {} indices", indices.size());
+		return {};
+	}
+
+	const MeshHandle mesh = {
+		.firstVertex = static_cast<uint32_t>(*firstVertex),
+		.vertexCount = vertexCount,
+		.firstIndex = static_cast<uint32_t>(*firstIndex),
+		.indexCount = static_cast<uint32_t>(indices.size()),
+		.stream = stream
+	};
+
+	const auto vertexBuffer = stream == VertexStream::Mesh ? meshVertexBuffer_ : vertexBuffer_;
+	if (!staging_.uploadBuffer(vertices, vertexBuffer, stride * mesh.firstVertex)
+		|| !staging_.uploadBuffer(std::as_bytes(indices), indexBuffer_, sizeof(uint32_t) * mesh.firstIndex)) {
+		release(mesh);
+		spdlog::warn("Failed to reserve staging memory for a mesh");
+		return {};
+	}
+	staging_.flush();
+	return mesh;
+}
+
+void GeometryStore::remove(const MeshHandle& mesh)
+{
+	if (mesh)
+		retired_.push_back({mesh, frame_});
+}
+
+void GeometryStore::beginFrame(uint64_t frame, uint64_t oldestInFlight)
+{
+	frame_ = frame;
+	std::erase_if(retired_, [&](const Retired& r) {
+		if (r.frame >= oldestInFlight)
+			return false;
+		release(r.mesh);
+		return true;
+	});
+}
+
+void GeometryStore::release(const MeshHandle& mesh)
+{
+	auto& vertexRanges = mesh.stream == VertexStream::Mesh ? meshVertexRanges_ : vertexRanges_;
+	vertexRanges.free(mesh.firstVertex, mesh.vertexCount);
+	indexRanges_.free(mesh.firstIndex, mesh.indexCount);
+}
+
+void GeometryStore::bind(vk::CommandBuffer cmd, VertexStream stream) const
+{
+	std::array<vk::Buffer, 1> vertexBuffers = {{ stream == VertexStream::Mesh ? meshVertexBuffer_ : vertexBuffer_ }};
+	std::array<vk::DeviceSize, 1> offsets = {{ 0 }};
+	cmd.bindVertexBuffers(0, vertexBuffers, offsets);
+	cmd.bindIndexBuffer(indexBuffer_, 0u, vk::IndexType::eUint32);
+}
+
+void GeometryStore::draw(vk::CommandBuffer cmd, const MeshHandle& mesh, uint32_t instanceCount, uint32_t firstInstance) const
+{
+	cmd.drawIndexed(mesh.indexCount, instanceCount, mesh.firstIndex,
+		static_cast<int32_t>(mesh.firstVertex), firstInstance);
+}
+
+}
@@ -0,0 +1,99 @@
+//
+// Created by ocean on 3/13/22.
+//
+
+#ifndef GEOMETRYSTORE_HPP
+#define GEOMETRYSTORE_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_mem_alloc.h"
+#include "RangeAllocator.hpp"
+#include "MeshFile.hpp"
+#include "StagingRing.hpp"
+#include "Vertex.hpp"
+
+namespace VulkanPlayground
+{
+
+struct MeshHandle
+{
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	// Vertex buffer firstVertex is in
+	VertexStream stream = VertexStream::Quad;
+
+	explicit operator bool() const { return indexCount != 0; }
+};
+
+/// Engine lifetime vertex and index buffers that meshes are suballocated from.
+/// Everything of a VertexStream is drawn after a single bind(), indices are
+/// relative to the mesh and rebased through the vertexOffset of the draw.
+class GeometryStore
+{
+public:
+	GeometryStore(VmaAllocator allocator, StagingRing& staging,
+		uint32_t vertexCapacity = 1u << 20, uint32_t indexCapacity = 1u << 22,
+		uint32_t meshVertexCapacity = 1u << 20);
+	~GeometryStore();
+
+	GeometryStore(const GeometryStore&) = delete;
+	GeometryStore& operator=(const GeometryStore&) = delete;
+
+	/// Upload a mesh, returns an empty handle when the store is full.
+	/// The copy is submitted right away and ordered before any later frame.
+	MeshHandle add(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+	/// Upload an imported mesh to the Mesh stream, staged straight from the
+	/// mapping. Meshlets are left out, nothing draws them yet.
+	MeshHandle add(const MeshFile& mesh);
+	/// Frames recorded up to now may still draw the mesh, its ranges are reused
+	/// once beginFrame reports all of them retired
+	void remove(const MeshHandle& mesh);
+
+	/// Called once per frame, frames before oldestInFlight have completed on the GPU
+	void beginFrame(uint64_t frame, uint64_t oldestInFlight);
+
+	void bind(vk::CommandBuffer cmd, VertexStream stream = VertexStream::Quad) const;
+	void draw(vk::CommandBuffer cmd, const MeshHandle& mesh, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const;
+
+	vk::Buffer vertexBuffer() const { return vertexBuffer_; }
+	vk::Buffer indexBuffer() const { return indexBuffer_; }
+
+private:
+	struct Retired
+	{
+		MeshHandle mesh;
+		uint64_t frame;
+	};
+
+	MeshHandle add(VertexStream stream, std::span<const std::byte> vertices, size_t stride,
+		std::span<const uint32_t> indices);
+	void release(const MeshHandle& mesh);
+
+	VmaAllocator allocator_;
+	StagingRing& staging_;
+
+	vk::Buffer vertexBuffer_;
+	VmaAllocation vertexAlloc_;
+	vk::Buffer meshVertexBuffer_;
+	VmaAllocation meshVertexAlloc_;
+	vk::Buffer indexBuffer_;
+	VmaAllocation indexAlloc_;
+
+	RangeAllocator vertexRanges_;
+	RangeAllocator meshVertexRanges_;
+	RangeAllocator indexRanges_;
+
+	uint64_t frame_ = 0;
+	std::vector<Retired> retired_;
+};
+
+}
+
+#endif //GEOMETRYSTORE_HPP
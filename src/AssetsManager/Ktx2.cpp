@@ -0,0 +1,271 @@
+//
+// Created by ocean on 3/27/22.
+//
+
+#include "Ktx2.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include <spdlog/spdlog.h>
+
+#include "Mipmaps.hpp"
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr std::array<uint8_t, 12> identifier = {
+	0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+struct Header
+{
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+// Khronos Data Format descriptor values for the formats written
+constexpr uint32_t dfdModelRgbsda = 1;
+constexpr uint32_t dfdModelBc1a = 128;
+constexpr uint32_t dfdModelBc7 = 134;
+constexpr uint32_t dfdModelEtc2 = 161;
+constexpr uint32_t dfdPrimariesBt709 = 1;
+constexpr uint32_t dfdTransferLinear = 1;
+constexpr uint32_t dfdTransferSrgb = 2;
+
+bool isSrgb(vk::Format format)
+{
+	using enum vk::Format;
+	switch (format) {
+	case eR8G8B8A8Srgb:
+	case eBc1RgbSrgbBlock:
+	case eBc1RgbaSrgbBlock:
+	case eBc7SrgbBlock:
+	case eEtc2R8G8B8SrgbBlock:
+	case eEtc2R8G8B8A1SrgbBlock:
+	case eEtc2R8G8B8A8SrgbBlock:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Basic data format descriptor, one sample per block for compressed formats
+std::vector<uint32_t> descriptor(vk::Format format)
+{
+	using enum vk::Format;
+	const auto block = blockFormat(format);
+	uint32_t model;
+	// bit offset, bit length and channel of each sample
+	std::vector<std::array<uint32_t, 3>> samples;
+	switch (format) {
+	case eR8G8B8A8Srgb:
+	case eR8G8B8A8Unorm:
+		model = dfdModelRgbsda;
+		// Alpha is the last channel id and never sRGB encoded
+		samples = {{0, 8, 0}, {8, 8, 1}, {16, 8, 2}, {24, 8, 15}};
+		break;
+	case eBc1RgbSrgbBlock:
+	case eBc1RgbUnormBlock:
+		model = dfdModelBc1a;
+		samples = {{0, 64, 0}};
+		break;
+	case eBc7SrgbBlock:
+	case eBc7UnormBlock:
+		model = dfdModelBc7;
+		samples = {{0, 128, 0}};
+		break;
+	default:
+		model = dfdModelEtc2;
+		samples = {{0, block.bytes * 8, 2}};
+		break;
+	}
+
+	const auto blockSize = static_cast<uint32_t>(24 + 16 * samples.size());
+	std::vector<uint32_t> dfd;
+	dfd.push_back(4 + blockSize);
+	// Khronos vendor, basic descriptor type
+	dfd.push_back(0);
+	dfd.push_back(2u | blockSize << 16);
+	dfd.push_back(model | dfdPrimariesBt709 << 8 | (isSrgb(format) ? dfdTransferSrgb : dfdTransferLinear) << 16);
+	dfd.push_back((block.extent - 1) | (block.extent - 1) << 8);
+	dfd.push_back(block.bytes);
+	dfd.push_back(0);
+	for (const auto& [offset, length, channel] : samples) {
+		// Alpha in an sRGB format is linear
+		const uint32_t linear = isSrgb(format) && channel == 15 ? 0x10u : 0u;
+		dfd.push_back(offset | (length - 1) << 16 | (channel | linear) << 24);
+		dfd.push_back(0);
+		dfd.push_back(0);
+		dfd.push_back(length >= 32 ? UINT32_MAX : (1u << length) - 1);
+	}
+	return dfd;
+}
+
+size_t alignUp(size_t v, size_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+}
+
+bool Ktx2Texture::read(const char* path, Ktx2Texture& texture)
+{
+	const auto file = std::fopen(path, "rb");
+	if (!file) {
+		spdlog::error("Failed to open file: {}", path);
+		return false;
+	}
+	std::fseek(file, 0, SEEK_END);
+	const auto size = static_cast<size_t>(std::ftell(file));
+	std::fseek(file, 0, SEEK_SET);
+	std::vector<uint8_t> data(size);
+	const auto readIn = std::fread(data.data(), 1, size, file);
+	std::fclose(file);
+	if (readIn != size) {
+		spdlog::error("Failed to read file: {}", path);
+		return false;
+	}
+	return parse(std::move(data), texture, path);
+}
+
+bool Ktx2Texture::parse(std::vector<uint8_t> file, Ktx2Texture& texture, const char* name)
+{
+	Header header;
+	if (file.size() < sizeof(header)) {
+		spdlog::error("{} is not a KTX2 file", name);
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (!std::equal(identifier.begin(), identifier.end(), header.identifier)) {
+		spdlog::error("{} is not a KTX2 file", name);
+		return false;
+	}
+
+	const auto format = static_cast<vk::Format>(header.vkFormat);
+	if (!blockFormat(format).extent) {
+		spdlog::error("{}: unsupported format {}", name, to_string(format));
+		return false;
+	}
+	if (header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1
+		|| header.pixelWidth == 0 || header.pixelHeight == 0) {
+		spdlog::error("{}: only uncompressed single 2D images are supported", name);
+		return false;
+	}
+
+	const uint32_t levelCount = std::max(1u, header.levelCount);
+	// More levels than the full chain would shift past the width and ask Vulkan for too many mips
+	if (levelCount > mipLevelCount(header.pixelWidth, header.pixelHeight)) {
+		spdlog::error("{}: malformed level count {} for {}x{}", name, levelCount, header.pixelWidth, header.pixelHeight);
+		return false;
+	}
+	if (file.size() < sizeof(header) + sizeof(LevelIndex) * size_t {levelCount}) {
+		spdlog::error("{}: truncated level index", name);
+		return false;
+	}
+
+	std::vector<Level> levels(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		LevelIndex index;
+		std::memcpy(&index, file.data() + sizeof(header) + sizeof(index) * i, sizeof(index));
+		const auto expected = imageBytes(format, std::max(1u, header.pixelWidth >> i), std::max(1u, header.pixelHeight >> i));
+		if (index.byteLength < expected || index.byteOffset > file.size() || index.byteLength > file.size() - index.byteOffset) {
+			spdlog::error("{}: level {} is out of bounds", name, i);
+			return false;
+		}
+		levels[i] = {static_cast<size_t>(index.byteOffset), expected};
+	}
+
+	texture.format = format;
+	texture.width = header.pixelWidth;
+	texture.height = header.pixelHeight;
+	texture.levels = std::move(levels);
+	texture.data = std::move(file);
+	return true;
+}
+
+bool Ktx2Texture::write(const char* path, vk::Format format, uint32_t width, uint32_t height,
+	const std::vector<std::vector<uint8_t>>& levels)
+{
+	const auto block = blockFormat(format);
+	if (!block.extent || levels.empty()) {
+		spdlog::error("Cannot write {} as {}", path, to_string(format));
+		return false;
+	}
+
+	const auto dfd = descriptor(format);
+	const auto levelCount = static_cast<uint32_t>(levels.size());
+	const size_t dfdOffset = sizeof(Header) + sizeof(LevelIndex) * levelCount;
+	const size_t dfdBytes = dfd.size() * sizeof(uint32_t);
+	const size_t alignment = std::lcm<size_t>(block.bytes, 4);
+
+	// Level data goes smallest first, so streaming the file front to back
+	// yields something displayable early
+	std::vector<LevelIndex> index(levelCount);
+	size_t offset = dfdOffset + dfdBytes;
+	for (uint32_t i = levelCount; i-- > 0;) {
+		offset = alignUp(offset, alignment);
+		index[i] = {offset, levels[i].size(), levels[i].size()};
+		offset += levels[i].size();
+	}
+
+	Header header {};
+	std::copy(identifier.begin(), identifier.end(), header.identifier);
+	header.vkFormat = static_cast<uint32_t>(format);
+	// Byte sized components, and 1 by definition for block compressed formats
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.dfdByteOffset = static_cast<uint32_t>(dfdOffset);
+	header.dfdByteLength = static_cast<uint32_t>(dfdBytes);
+
+	std::vector<uint8_t> out(offset);
+	std::memcpy(out.data(), &header, sizeof(header));
+	std::memcpy(out.data() + sizeof(header), index.data(), sizeof(LevelIndex) * levelCount);
+	std::memcpy(out.data() + dfdOffset, dfd.data(), dfdBytes);
+	for (uint32_t i = 0; i < levelCount; i++)
+		std::memcpy(out.data() + index[i].byteOffset, levels[i].data(), levels[i].size());
+
+	const auto file = std::fopen(path, "wb");
+	if (!file) {
+		spdlog::error("Failed to open file: {}", path);
+		return false;
+	}
+	const bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+	if (std::fclose(file) != 0 || !ok) {
+		spdlog::error("Failed to write file: {}", path);
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,50 @@
+//
+// Created by ocean on 3/27/22.
+//
+
+#ifndef KTX2_HPP
+#define KTX2_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "TextureFormat.hpp"
+
+namespace VulkanPlayground
+{
+
+/// A single 2D image with its mip chain in a KTX2 container.
+/// Only what the engine produces and consumes is supported: no array
+/// layers, cube faces, depth or supercompression.
+struct Ktx2Texture
+{
+	struct Level
+	{
+		// Into data
+		size_t offset;
+		size_t size;
+	};
+
+	vk::Format format = vk::Format::eUndefined;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// Largest first
+	std::vector<Level> levels;
+	std::vector<uint8_t> data;
+
+	/// Logs and returns false when the file is malformed or unsupported
+	static bool read(const char* path, Ktx2Texture& texture);
+	/// Validates a container already in memory, taking ownership of it
+	static bool parse(std::vector<uint8_t> file, Ktx2Texture& texture, const char* name);
+
+	/// levels holds the payload of each level, largest first
+	static bool write(const char* path, vk::Format format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels);
+};
+
+}
+
+#endif //KTX2_HPP
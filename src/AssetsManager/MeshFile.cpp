@@ -0,0 +1,227 @@
+//
+// Created by ocean on 4/7/22.
+//
+
+#include "MeshFile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr std::array<char, 4> fileMagic { 'V', 'P', 'M', 'S' };
+// 2 packs normals and texture coordinates
+constexpr uint32_t fileVersion = 2;
+// Arrays start on this, the mapping itself is page aligned
+constexpr uint32_t arrayAlignment = 16;
+
+enum Array : uint32_t
+{
+	Vertices,
+	Indices,
+	Meshlets,
+	MeshletVertices,
+	MeshletTriangles,
+	ArrayCount
+};
+
+// Offsets are from the start of the file, sizes in bytes
+struct FileArray
+{
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct FileHeader
+{
+	std::array<char, 4> magic;
+	uint32_t version;
+	uint32_t fileSize;
+	uint32_t vertexSize;
+	glm::vec4 bounds;
+	std::array<FileArray, ArrayCount> arrays;
+};
+
+size_t alignUp(size_t v, size_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+template<typename T>
+std::span<const T> array(const void* map, const FileArray& a)
+{
+	return {reinterpret_cast<const T *>(static_cast<const std::byte *>(map) + a.offset), a.size / sizeof(T)};
+}
+
+// Ritter's sphere, within a few percent of the smallest one
+glm::vec4 boundingSphere(std::span<const MeshVertex> vertices)
+{
+	if (vertices.empty())
+		return glm::vec4(0.0f);
+	const auto farthest = [&](const glm::vec3& from) {
+		return std::max_element(vertices.begin(), vertices.end(), [&](const MeshVertex& a, const MeshVertex& b) {
+			return glm::length(a.position - from) < glm::length(b.position - from);
+		})->position;
+	};
+	const auto a = farthest(vertices[0].position);
+	const auto b = farthest(a);
+	auto center = (a + b) * 0.5f;
+	auto radius = glm::length(b - a) * 0.5f;
+	for (const auto& vertex : vertices) {
+		const auto distance = glm::length(vertex.position - center);
+		if (distance > radius) {
+			const auto grown = (radius + distance) * 0.5f;
+			center += (vertex.position - center) * ((grown - radius) / distance);
+			radius = grown;
+		}
+	}
+	return glm::vec4(center, radius);
+}
+
+}
+
+MeshFile::MeshFile(void* map, size_t size)
+	: map_(map), mapSize_(size)
+{
+}
+
+std::unique_ptr<MeshFile> MeshFile::open(const char* path)
+{
+	const auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		spdlog::error("Failed to open file: {}", path);
+		return nullptr;
+	}
+	struct stat st {};
+	void* map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FileHeader))
+		map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		spdlog::error("Failed to map mesh {}", path);
+		return nullptr;
+	}
+
+	std::unique_ptr<MeshFile> mesh(new MeshFile(map, st.st_size));
+	if (!mesh->validate(path))
+		return nullptr;
+	return mesh;
+}
+
+MeshFile::~MeshFile()
+{
+	munmap(map_, mapSize_);
+}
+
+bool MeshFile::validate(const char* path)
+{
+	const auto header = static_cast<const FileHeader *>(map_);
+	if (header->magic != fileMagic || header->version != fileVersion || header->fileSize != mapSize_
+		|| header->vertexSize != sizeof(MeshVertex)) {
+		spdlog::error("{} is not a mesh or was built by another version", path);
+		return false;
+	}
+	for (const auto& a : header->arrays) {
+		if (size_t {a.offset} + a.size > mapSize_ || a.offset % arrayAlignment) {
+			spdlog::error("{}: arrays are out of bounds", path);
+			return false;
+		}
+	}
+
+	contents_ = {
+		.vertices = array<MeshVertex>(map_, header->arrays[Vertices]),
+		.indices = array<uint32_t>(map_, header->arrays[Indices]),
+		.meshlets = array<MeshOptimize::Meshlet>(map_, header->arrays[Meshlets]),
+		.meshletVertices = array<uint32_t>(map_, header->arrays[MeshletVertices]),
+		.meshletTriangles = array<uint8_t>(map_, header->arrays[MeshletTriangles])
+	};
+	bounds_ = header->bounds;
+
+	// Indices are trusted from here on, a bad one would read past the vertex buffer
+	const auto vertexCount = contents_.vertices.size();
+	if (contents_.indices.size() % 3
+		|| std::any_of(contents_.indices.begin(), contents_.indices.end(), [&](uint32_t i) { return i >= vertexCount; })) {
+		spdlog::error("{}: indices are out of range", path);
+		return false;
+	}
+	for (const auto& meshlet : contents_.meshlets) {
+		if (size_t {meshlet.vertexOffset} + meshlet.vertexCount > contents_.meshletVertices.size()
+			|| size_t {meshlet.triangleOffset} + size_t {meshlet.triangleCount} * 3 > contents_.meshletTriangles.size()) {
+			spdlog::error("{}: meshlets are out of range", path);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool MeshFile::write(const char* path, const Contents& contents)
+{
+	const auto vertexCount = contents.vertices.size();
+	if (contents.indices.size() % 3
+		|| std::any_of(contents.indices.begin(), contents.indices.end(), [&](uint32_t i) { return i >= vertexCount; })) {
+		spdlog::error("Mesh {} has indices out of range", path);
+		return false;
+	}
+
+	const std::array<std::span<const std::byte>, ArrayCount> arrays {
+		std::as_bytes(contents.vertices),
+		std::as_bytes(contents.indices),
+		std::as_bytes(contents.meshlets),
+		std::as_bytes(contents.meshletVertices),
+		std::as_bytes(contents.meshletTriangles)
+	};
+	FileHeader header {};
+	size_t offset = sizeof(FileHeader);
+	for (size_t i = 0; i < ArrayCount; i++) {
+		offset = alignUp(offset, arrayAlignment);
+		header.arrays[i] = {static_cast<uint32_t>(offset), static_cast<uint32_t>(arrays[i].size())};
+		offset += arrays[i].size();
+	}
+	if (offset > UINT32_MAX) {
+		spdlog::error("Mesh {} would be larger than 4 GiB", path);
+		return false;
+	}
+	header.magic = fileMagic;
+	header.version = fileVersion;
+	header.fileSize = static_cast<uint32_t>(offset);
+	header.vertexSize = sizeof(MeshVertex);
+	header.bounds = boundingSphere(contents.vertices);
+
+	std::vector<std::byte> out(offset);
+	std::memcpy(out.data(), &header, sizeof(header));
+	for (size_t i = 0; i < ArrayCount; i++) {
+		if (!arrays[i].empty())
+			std::memcpy(out.data() + header.arrays[i].offset, arrays[i].data(), arrays[i].size());
+	}
+
+	// Renamed into place, a running engine keeps its mapping of the old mesh
+	const auto tmpPath = std::string(path) + ".tmp";
+	const auto file = std::fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		spdlog::error("Failed to open file: {}", tmpPath);
+		return false;
+	}
+	const bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+	if (std::fclose(file) != 0 || !ok || std::rename(tmpPath.c_str(), path) != 0) {
+		spdlog::error("Failed to write file: {}", path);
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
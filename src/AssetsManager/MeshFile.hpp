@@ -0,0 +1,79 @@
+//
+// Created by ocean on 4/7/22.
+//
+
+#ifndef MESHFILE_HPP
+#define MESHFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "MeshOptimize.hpp"
+#include "VertexLayout.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Vertex of an imported mesh as it is stored, 20 bytes
+struct MeshVertex
+{
+	glm::vec3 position;
+	Snorm1010102 normal;
+	Half2 uv;
+};
+
+template<>
+struct VertexInput<MeshVertex>
+{
+	constexpr static auto layout = vertexLayout<MeshVertex>(0, vk::VertexInputRate::eVertex, 0,
+		VERTEX_ATTRIBUTE(MeshVertex, position),
+		VERTEX_ATTRIBUTE(MeshVertex, normal),
+		VERTEX_ATTRIBUTE(MeshVertex, uv));
+};
+
+/// A mesh written by the MeshImporter tool, already in the order the GPU
+/// prefers, so the file is mapped and its arrays handed out in place.
+class MeshFile
+{
+public:
+	struct Contents
+	{
+		std::span<const MeshVertex> vertices;
+		std::span<const uint32_t> indices;
+		// Empty when the mesh was not split
+		std::span<const MeshOptimize::Meshlet> meshlets;
+		std::span<const uint32_t> meshletVertices;
+		std::span<const uint8_t> meshletTriangles;
+	};
+
+	/// Logs and returns nullptr when the file is missing or malformed
+	static std::unique_ptr<MeshFile> open(const char* path);
+	~MeshFile();
+
+	MeshFile(const MeshFile&) = delete;
+	MeshFile& operator=(const MeshFile&) = delete;
+
+	const Contents& contents() const { return contents_; }
+	/// Center and radius of a sphere around the vertices
+	glm::vec4 bounds() const { return bounds_; }
+
+	/// Logs and returns false when an index is out of range or the file cannot be written
+	static bool write(const char* path, const Contents& contents);
+
+private:
+	MeshFile(void* map, size_t size);
+	bool validate(const char* path);
+
+	void* map_ = nullptr;
+	size_t mapSize_ = 0;
+	Contents contents_;
+	glm::vec4 bounds_ {0.0f};
+};
+
+}
+
+#endif //MESHFILE_HPP
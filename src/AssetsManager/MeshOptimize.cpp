@@ -0,0 +1,343 @@
+//
+// Created by ocean on 4/7/22.
+//
+
+#include "MeshOptimize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace VulkanPlayground::MeshOptimize
+{
+
+namespace {
+
+// Forsyth's published tuning
+constexpr float cacheDecayPower = 1.5f;
+constexpr float lastTriangleScore = 0.75f;
+constexpr float valenceBoostScale = 2.0f;
+constexpr float valenceBoostPower = 0.5f;
+
+float vertexScore(int cachePosition, uint32_t liveTriangles)
+{
+	if (liveTriangles == 0)
+		return -1.0f;
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// The last triangle's vertices score the same, whichever is reused
+		// next its neighbors are left as they are
+		if (cachePosition < 3) {
+			score = lastTriangleScore;
+		} else {
+			constexpr float scale = 1.0f / (cacheSize - 3);
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scale, cacheDecayPower);
+		}
+	}
+	// Vertices with few triangles left are finished off before they are evicted
+	return score + valenceBoostScale * std::pow(static_cast<float>(liveTriangles), -valenceBoostPower);
+}
+
+// Triangles of every vertex, packed in one array
+struct Adjacency
+{
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+};
+
+Adjacency buildAdjacency(std::span<const uint32_t> indices, size_t vertexCount)
+{
+	Adjacency adjacency;
+	adjacency.counts.assign(vertexCount, 0);
+	adjacency.offsets.assign(vertexCount + 1, 0);
+	adjacency.triangles.resize(indices.size());
+	for (const auto index : indices)
+		adjacency.counts[index]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacency.offsets[v + 1] = adjacency.offsets[v] + adjacency.counts[v];
+
+	std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	return adjacency;
+}
+
+// A FIFO of cacheSize entries: a vertex is cached while fewer than cacheSize
+// vertices were added after it
+class CacheModel
+{
+public:
+	explicit CacheModel(size_t vertexCount) : added_(vertexCount, 0) {}
+
+	/// Whether v had to be transformed
+	bool use(uint32_t v)
+	{
+		if (time_ - added_[v] <= cacheSize)
+			return false;
+		added_[v] = time_++;
+		return true;
+	}
+	/// Everything in the cache is evicted
+	void reset() { time_ += cacheSize; }
+
+private:
+	std::vector<uint32_t> added_;
+	uint32_t time_ = cacheSize + 1;
+};
+
+}
+
+CacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount)
+{
+	CacheStats stats;
+	if (indices.size() < 3)
+		return stats;
+
+	CacheModel cache(vertexCount);
+	std::vector<bool> used(vertexCount);
+	size_t misses = 0, unique = 0;
+	for (const auto index : indices) {
+		misses += cache.use(index);
+		if (!used[index]) {
+			used[index] = true;
+			unique++;
+		}
+	}
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+	return stats;
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// The live triangles of a vertex come first in its part of the adjacency
+	auto adjacency = buildAdjacency(indices, vertexCount);
+	auto& live = adjacency.counts;
+	const auto liveTriangles = [&](uint32_t v) {
+		const auto begin = adjacency.triangles.begin() + adjacency.offsets[v];
+		return std::span<uint32_t>(begin, begin + live[v]);
+	};
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(-1, live[v]);
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+	std::vector<bool> emitted(triangleCount);
+
+	std::vector<uint32_t> out;
+	out.reserve(indices.size());
+	// Room for the vertices of the emitted triangle before the oldest are pushed out
+	std::array<uint32_t, cacheSize + 3> cache {}, next {};
+	size_t cached = 0;
+	size_t cursor = 0;
+	auto best = static_cast<uint32_t>(std::max_element(triangleScore.begin(), triangleScore.end())
+		- triangleScore.begin());
+
+	for (size_t n = 0; n < triangleCount; n++) {
+		if (best == UINT32_MAX) {
+			// Nothing cached has triangles left, carry on where the input is
+			while (emitted[cursor])
+				cursor++;
+			best = static_cast<uint32_t>(cursor);
+		}
+		const std::array<uint32_t, 3> triangle {indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2]};
+		out.insert(out.end(), triangle.begin(), triangle.end());
+		emitted[best] = true;
+
+		size_t count = 0;
+		for (const auto v : triangle) {
+			auto triangles = liveTriangles(v);
+			std::iter_swap(std::find(triangles.begin(), triangles.end(), best), triangles.end() - 1);
+			live[v]--;
+			if (std::find(next.begin(), next.begin() + count, v) == next.begin() + count)
+				next[count++] = v;
+		}
+		for (size_t i = 0; i < cached; i++) {
+			if (std::find(triangle.begin(), triangle.end(), cache[i]) == triangle.end())
+				next[count++] = cache[i];
+		}
+
+		// Rescore what moved, including what just fell out of the cache
+		for (size_t i = 0; i < count; i++) {
+			const auto v = next[i];
+			cachePosition[v] = i < cacheSize ? static_cast<int>(i) : -1;
+			const auto rescored = vertexScore(cachePosition[v], live[v]);
+			for (const auto t : liveTriangles(v))
+				triangleScore[t] += rescored - score[v];
+			score[v] = rescored;
+		}
+
+		cached = std::min<size_t>(count, cacheSize);
+		std::copy(next.begin(), next.begin() + cached, cache.begin());
+		best = UINT32_MAX;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < cached; i++) {
+			for (const auto t : liveTriangles(cache[i])) {
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+	}
+	std::copy(out.begin(), out.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+	const float acmr = analyzeVertexCache(indices, positions.size()).acmr;
+
+	// The cache order starts over where a triangle misses every vertex
+	std::vector<size_t> hard {0};
+	CacheModel cache(positions.size());
+	for (size_t t = 0; t < triangleCount; t++) {
+		unsigned misses = 0;
+		for (size_t k = 0; k < 3; k++)
+			misses += cache.use(indices[t * 3 + k]);
+		if (misses == 3 && t > 0)
+			hard.push_back(t);
+	}
+	hard.push_back(triangleCount);
+
+	// Within those, a cluster ends once it has paid for starting with a cold cache
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		size_t start = hard[h];
+		size_t misses = 0;
+		cache.reset();
+		clusters.push_back(start);
+		for (size_t t = hard[h]; t < hard[h + 1]; t++) {
+			for (size_t k = 0; k < 3; k++)
+				misses += cache.use(indices[t * 3 + k]);
+			const auto clusterAcmr = static_cast<float>(misses) / static_cast<float>(t + 1 - start);
+			if (clusterAcmr <= acmr * threshold && t + 1 < hard[h + 1]) {
+				start = t + 1;
+				misses = 0;
+				cache.reset();
+				clusters.push_back(start);
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Area weighted centroids and normals
+	struct Cluster
+	{
+		size_t begin, end;
+		glm::vec3 centroid {0.0f};
+		glm::vec3 normal {0.0f};
+		float area = 0.0f;
+		float sortKey = 0.0f;
+	};
+	std::vector<Cluster> sorted(clusters.size() - 1);
+	glm::vec3 meshCentroid {0.0f};
+	float meshArea = 0.0f;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		auto& cluster = sorted[i];
+		cluster.begin = clusters[i];
+		cluster.end = clusters[i + 1];
+		for (size_t t = cluster.begin; t < cluster.end; t++) {
+			const auto& a = positions[indices[t * 3]];
+			const auto& b = positions[indices[t * 3 + 1]];
+			const auto& c = positions[indices[t * 3 + 2]];
+			const auto normal = glm::cross(b - a, c - a);
+			const auto area = glm::length(normal);
+			cluster.centroid += (a + b + c) * (area / 3.0f);
+			cluster.normal += normal;
+			cluster.area += area;
+		}
+		meshCentroid += cluster.centroid;
+		meshArea += cluster.area;
+		if (cluster.area > 0.0f)
+			cluster.centroid /= cluster.area;
+	}
+	if (meshArea <= 0.0f)
+		return;
+	meshCentroid /= meshArea;
+
+	// Facing away from the middle of the mesh, the cluster covers more than it is covered
+	for (auto& cluster : sorted) {
+		const auto length = glm::length(cluster.normal);
+		if (length > 0.0f)
+			cluster.sortKey = glm::dot(cluster.centroid - meshCentroid, cluster.normal / length);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> out;
+	out.reserve(indices.size());
+	for (const auto& cluster : sorted)
+		out.insert(out.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	std::copy(out.begin(), out.end(), indices.begin());
+}
+
+std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t next = 0;
+	for (auto& index : indices) {
+		if (remap[index] == UINT32_MAX)
+			remap[index] = next++;
+		index = remap[index];
+	}
+	return remap;
+}
+
+Meshlets buildMeshlets(std::span<const uint32_t> indices, size_t vertexCount, uint32_t maxVertices,
+	uint32_t maxTriangles)
+{
+	maxVertices = std::clamp(maxVertices, 3u, 256u);
+	maxTriangles = std::max(maxTriangles, 1u);
+
+	Meshlets out;
+	// Index of a vertex in the current meshlet
+	std::vector<uint32_t> local(vertexCount, UINT32_MAX);
+	Meshlet meshlet {};
+	const auto finish = [&] {
+		if (meshlet.triangleCount == 0)
+			return;
+		out.meshlets.push_back(meshlet);
+		for (size_t i = meshlet.vertexOffset; i < out.vertices.size(); i++)
+			local[out.vertices[i]] = UINT32_MAX;
+		// Every meshlet's triangles start on a uint32_t
+		out.triangles.resize((out.triangles.size() + 3) & ~size_t {3});
+		meshlet = {
+			.vertexOffset = static_cast<uint32_t>(out.vertices.size()),
+			.triangleOffset = static_cast<uint32_t>(out.triangles.size()),
+			.vertexCount = 0,
+			.triangleCount = 0
+		};
+	};
+
+	for (size_t t = 0; t < indices.size() / 3; t++) {
+		const auto a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+		const uint32_t added = (local[a] == UINT32_MAX) + (local[b] == UINT32_MAX && b != a)
+			+ (local[c] == UINT32_MAX && c != a && c != b);
+		if (meshlet.vertexCount + added > maxVertices || meshlet.triangleCount == maxTriangles)
+			finish();
+
+		for (const auto v : {a, b, c}) {
+			if (local[v] == UINT32_MAX) {
+				local[v] = meshlet.vertexCount++;
+				out.vertices.push_back(v);
+			}
+			out.triangles.push_back(static_cast<uint8_t>(local[v]));
+		}
+		meshlet.triangleCount++;
+	}
+	finish();
+	return out;
+}
+
+}
@@ -0,0 +1,98 @@
+//
+// Created by ocean on 4/7/22.
+//
+
+#ifndef MESHOPTIMIZE_HPP
+#define MESHOPTIMIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace VulkanPlayground
+{
+
+/// Reordering of indexed triangle lists for the GPU, run offline by the
+/// MeshImporter tool. Indices are a triangle list into vertexCount vertices.
+namespace MeshOptimize
+{
+
+/// Post-transform cache entries the optimizers and the statistics assume.
+/// Current GPUs batch vertices rather than keep a true FIFO, a small cache
+/// is the model that best predicts how often they shade a vertex again.
+constexpr unsigned cacheSize = 16;
+
+struct CacheStats
+{
+	// Average cache miss ratio, vertices shaded per triangle, 0.5 at best
+	float acmr = 0.0f;
+	// Average transformed vertex ratio, vertices shaded per vertex, 1 at best
+	float atvr = 0.0f;
+};
+
+/// Simulates a FIFO post-transform cache of cacheSize entries
+CacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount);
+
+/// Reorders triangles for the post-transform cache with Tom Forsyth's linear
+/// speed algorithm: greedily emits the triangle whose vertices score best for
+/// being recently used and having few triangles left.
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+/// Reorders clusters of triangles so outward facing parts of the mesh draw
+/// first and hide what is behind them. Clusters end where the cache order
+/// already starts over, or where the cache stays within threshold of the
+/// ACMR of the cache order, so the cache is kept close to as good.
+/// After optimizeVertexCache.
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const glm::vec3> positions, float threshold = 1.05f);
+
+/// Numbers vertices in the order the indices first use them, so fetching them
+/// walks memory forward, and drops vertices no triangle uses. Rewrites the
+/// indices and returns the new index of every old vertex, UINT32_MAX for the
+/// dropped ones. Apply it to the vertices with remapVertices.
+std::vector<uint32_t> optimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount);
+
+template<typename V>
+std::vector<V> remapVertices(std::span<const V> vertices, std::span<const uint32_t> remap)
+{
+	size_t count = 0;
+	for (const auto to : remap)
+		count += to != UINT32_MAX;
+	std::vector<V> out(count);
+	for (size_t i = 0; i < remap.size(); i++) {
+		if (remap[i] != UINT32_MAX)
+			out[remap[i]] = vertices[i];
+	}
+	return out;
+}
+
+/// A cluster of triangles small enough for a mesh shader workgroup. Its
+/// triangles index into its own vertices, which index into the mesh.
+struct Meshlet
+{
+	// Into the meshlet vertices and meshlet triangles, three bytes a triangle
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
+struct Meshlets
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices;
+	std::vector<uint8_t> triangles;
+};
+
+/// Splits the triangles in their current order, best after the cache
+/// optimization has made neighbors close. maxVertices is at most 256.
+Meshlets buildMeshlets(std::span<const uint32_t> indices, size_t vertexCount,
+	uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+}
+
+}
+
+#endif //MESHOPTIMIZE_HPP
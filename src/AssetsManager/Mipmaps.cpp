@@ -0,0 +1,155 @@
+//
+// Created by ocean on 3/24/22.
+//
+
+#include "Mipmaps.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+// Linear values are 14 bit, so four of them still sum into 16 bit lanes
+constexpr uint32_t linearMax = (1u << 14) - 1;
+
+struct SrgbTables
+{
+	std::array<uint16_t, 256> toLinear;
+	std::array<uint8_t, linearMax + 1> toSrgb;
+
+	SrgbTables()
+	{
+		for (uint32_t i = 0; i < toLinear.size(); i++) {
+			const double c = i / 255.0;
+			const double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+			toLinear[i] = static_cast<uint16_t>(std::lround(l * linearMax));
+		}
+		for (uint32_t i = 0; i < toSrgb.size(); i++) {
+			const double l = static_cast<double>(i) / linearMax;
+			const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+			toSrgb[i] = static_cast<uint8_t>(std::lround(c * 255.0));
+		}
+	}
+};
+
+const SrgbTables& tables()
+{
+	static const SrgbTables t;
+	return t;
+}
+
+uint16_t alphaToLinear(uint8_t a)
+{
+	return static_cast<uint16_t>((a * linearMax + 127) / 255);
+}
+
+uint8_t alphaFromLinear(uint16_t a)
+{
+	return static_cast<uint8_t>((a * 255u + linearMax / 2) / linearMax);
+}
+
+// Average of 2x2 blocks, 4 channels of 16 bit per pixel. A single row or
+// column is averaged with itself.
+void downsample(const uint16_t* src, uint32_t w, uint32_t h, uint16_t* dst)
+{
+	const uint32_t dw = std::max(1u, w / 2);
+	const uint32_t dh = std::max(1u, h / 2);
+	for (uint32_t y = 0; y < dh; y++) {
+		const uint16_t* row0 = src + size_t {2 * y} * w * 4;
+		const uint16_t* row1 = h > 1 ? row0 + size_t {w} * 4 : row0;
+		uint16_t* out = dst + size_t {y} * dw * 4;
+		uint32_t x = 0;
+		if (w > 1) {
+#if defined(__SSE2__)
+			// Two output pixels from four input pixels of each row
+			const __m128i round = _mm_set1_epi16(2);
+			for (; x + 2 <= dw; x += 2) {
+				const auto a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+				const auto a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8 + 8));
+				const auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+				const auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8 + 8));
+				const auto v0 = _mm_add_epi16(a0, b0);
+				const auto v1 = _mm_add_epi16(a1, b1);
+				const auto h0 = _mm_add_epi16(v0, _mm_srli_si128(v0, 8));
+				const auto h1 = _mm_add_epi16(v1, _mm_srli_si128(v1, 8));
+				const auto sum = _mm_add_epi16(_mm_unpacklo_epi64(h0, h1), round);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_srli_epi16(sum, 2));
+			}
+#endif
+			for (; x < dw; x++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					const uint32_t sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+					out[x * 4 + c] = static_cast<uint16_t>((sum + 2) >> 2);
+				}
+			}
+		} else {
+			for (uint32_t c = 0; c < 4; c++)
+				out[c] = static_cast<uint16_t>((row0[c] + row1[c] + 1) >> 1);
+		}
+	}
+}
+
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+	return std::bit_width(std::max({width, height, 1u}));
+}
+
+size_t mipChainBytes(uint32_t width, uint32_t height, uint32_t levels)
+{
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < levels; i++) {
+		bytes += size_t {width} * height * 4;
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+	return bytes;
+}
+
+void generateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levels)
+{
+	if (levels < 2)
+		return;
+	const auto& t = tables();
+
+	std::vector<uint16_t> current(size_t {width} * height * 4);
+	for (size_t i = 0; i < current.size(); i += 4) {
+		current[i + 0] = t.toLinear[chain[i + 0]];
+		current[i + 1] = t.toLinear[chain[i + 1]];
+		current[i + 2] = t.toLinear[chain[i + 2]];
+		current[i + 3] = alphaToLinear(chain[i + 3]);
+	}
+	// Level 1 is only half of level 0 when the image is one texel wide or high.
+	// After the first swap, next holds level 0, which fits every later level.
+	std::vector<uint16_t> next(size_t {std::max(1u, width / 2)} * std::max(1u, height / 2) * 4);
+
+	uint8_t* out = chain + current.size();
+	for (uint32_t level = 1; level < levels; level++) {
+		downsample(current.data(), width, height, next.data());
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+
+		const size_t count = size_t {width} * height * 4;
+		for (size_t i = 0; i < count; i += 4) {
+			out[i + 0] = t.toSrgb[next[i + 0]];
+			out[i + 1] = t.toSrgb[next[i + 1]];
+			out[i + 2] = t.toSrgb[next[i + 2]];
+			out[i + 3] = alphaFromLinear(next[i + 3]);
+		}
+		out += count;
+		std::swap(current, next);
+	}
+}
+
+}
@@ -0,0 +1,27 @@
+//
+// Created by ocean on 3/24/22.
+//
+
+#ifndef MIPMAPS_HPP
+#define MIPMAPS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanPlayground
+{
+
+/// Levels down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+/// Bytes of a tightly packed RGBA8 chain, levels back to back from the largest
+size_t mipChainBytes(uint32_t width, uint32_t height, uint32_t levels);
+
+/// Fill in the levels after the first of an sRGB RGBA8 chain laid out as
+/// mipChainBytes describes. Each level is a 2x2 box filter of the previous
+/// one, averaged in linear space so the chain does not darken like it would
+/// filtering the encoded values. For devices that cannot blit the format.
+void generateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levels);
+
+}
+
+#endif //MIPMAPS_HPP
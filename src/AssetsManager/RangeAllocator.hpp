@@ -0,0 +1,91 @@
+//
+// Created by ocean on 3/13/22.
+//
+
+#ifndef RANGEALLOCATOR_HPP
+#define RANGEALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+
+namespace VulkanPlayground
+{
+
+/// First-fit free-list over [0, capacity), with neighbours coalesced on free.
+/// Only does the bookkeeping, units are up to the owner.
+class RangeAllocator
+{
+public:
+	explicit RangeAllocator(uint64_t capacity) : capacity_(capacity)
+	{
+		if (capacity_ > 0)
+			free_.emplace(0, capacity_);
+	}
+
+	std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1)
+	{
+		if (size == 0)
+			return std::nullopt;
+		for (auto it = free_.begin(); it != free_.end(); ++it) {
+			const auto [offset, length] = *it;
+			const auto aligned = (offset + alignment - 1) / alignment * alignment;
+			const auto padding = aligned - offset;
+			if (length < padding + size)
+				continue;
+
+			free_.erase(it);
+			if (padding > 0)
+				free_.emplace(offset, padding);
+			if (length > padding + size)
+				free_.emplace(aligned + size, length - padding - size);
+			used_ += size;
+			return aligned;
+		}
+		return std::nullopt;
+	}
+
+	void free(uint64_t offset, uint64_t size)
+	{
+		if (size == 0)
+			return;
+		used_ -= size;
+		auto next = free_.lower_bound(offset);
+		if (next != free_.begin()) {
+			const auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				offset = prev->first;
+				size += prev->second;
+				free_.erase(prev);
+			}
+		}
+		if (next != free_.end() && offset + size == next->first) {
+			size += next->second;
+			free_.erase(next);
+		}
+		free_.emplace(offset, size);
+	}
+
+	uint64_t capacity() const { return capacity_; }
+	uint64_t used() const { return used_; }
+	/// Size of the largest free range, what a single allocation can get at most
+	uint64_t largestFree() const
+	{
+		uint64_t largest = 0;
+		for (const auto& [offset, length] : free_)
+			largest = std::max(largest, length);
+		return largest;
+	}
+
+private:
+	uint64_t capacity_;
+	uint64_t used_ = 0;
+	// offset -> length of every free range, never adjacent to each other
+	std::map<uint64_t, uint64_t> free_;
+};
+
+}
+
+#endif //RANGEALLOCATOR_HPP
@@ -0,0 +1,217 @@
+//
+// Created by ocean on 3/31/22.
+//
+
+#include "ShaderPack.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr std::array<char, 4> fileMagic { 'V', 'P', 'S', 'P' };
+constexpr uint32_t fileVersion = 1;
+constexpr uint32_t spirvMagic = 0x07230203;
+// Modules start on this, the mapping itself is page aligned
+constexpr uint32_t codeAlignment = 16;
+
+struct FileHeader
+{
+	std::array<char, 4> magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t fileSize;
+};
+
+// Sorted by name. Offsets are from the start of the file.
+struct FileEntry
+{
+	uint32_t nameOffset;
+	uint32_t nameSize;
+	uint32_t codeOffset;
+	uint32_t codeSize;
+};
+
+const FileEntry* entries(const void* map)
+{
+	return reinterpret_cast<const FileEntry *>(static_cast<const std::byte *>(map) + sizeof(FileHeader));
+}
+
+size_t alignUp(size_t v, size_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+}
+
+ShaderPack::ShaderPack(void* map, size_t size)
+	: map_(map), mapSize_(size), count_(static_cast<const FileHeader *>(map)->count)
+{
+}
+
+std::unique_ptr<ShaderPack> ShaderPack::open(const char* path)
+{
+	const auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		spdlog::error("Failed to open file: {}", path);
+		return nullptr;
+	}
+	struct stat st {};
+	void* map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FileHeader))
+		map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		spdlog::error("Failed to map shader pack {}", path);
+		return nullptr;
+	}
+
+	std::unique_ptr<ShaderPack> pack(new ShaderPack(map, st.st_size));
+	if (!pack->validate(path))
+		return nullptr;
+	return pack;
+}
+
+ShaderPack::~ShaderPack()
+{
+	munmap(map_, mapSize_);
+}
+
+bool ShaderPack::validate(const char* path) const
+{
+	const auto header = static_cast<const FileHeader *>(map_);
+	if (header->magic != fileMagic || header->version != fileVersion || header->fileSize != mapSize_
+		|| count_ > (mapSize_ - sizeof(FileHeader)) / sizeof(FileEntry)) {
+		spdlog::error("{} is not a shader pack or was built by another version", path);
+		return false;
+	}
+
+	const auto base = static_cast<const std::byte *>(map_);
+	for (size_t i = 0; i < count_; i++) {
+		const auto& entry = entries(map_)[i];
+		if (size_t {entry.nameOffset} + entry.nameSize > mapSize_
+			|| size_t {entry.codeOffset} + entry.codeSize > mapSize_) {
+			spdlog::error("{}: module {} is out of bounds", path, i);
+			return false;
+		}
+		if (entry.codeOffset % codeAlignment || entry.codeSize % sizeof(uint32_t) || entry.codeSize == 0) {
+			spdlog::error("{}: module {} is misaligned", path, name(i));
+			return false;
+		}
+		uint32_t magic;
+		std::memcpy(&magic, base + entry.codeOffset, sizeof(magic));
+		if (magic != spirvMagic) {
+			spdlog::error("{}: module {} is not SPIR-V", path, name(i));
+			return false;
+		}
+		if (i > 0 && name(i - 1) >= name(i)) {
+			spdlog::error("{}: modules are not sorted by name", path);
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string_view ShaderPack::name(size_t index) const
+{
+	const auto& entry = entries(map_)[index];
+	return {static_cast<const char *>(map_) + entry.nameOffset, entry.nameSize};
+}
+
+std::span<const uint32_t> ShaderPack::find(std::string_view name) const
+{
+	size_t lo = 0, hi = count_;
+	while (lo < hi) {
+		const auto mid = lo + (hi - lo) / 2;
+		const auto cmp = this->name(mid).compare(name);
+		if (cmp == 0) {
+			const auto& entry = entries(map_)[mid];
+			return {
+				reinterpret_cast<const uint32_t *>(static_cast<const std::byte *>(map_) + entry.codeOffset),
+				entry.codeSize / sizeof(uint32_t)
+			};
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return {};
+}
+
+bool ShaderPack::write(const char* path, std::vector<Module> modules)
+{
+	std::sort(modules.begin(), modules.end(), [](const Module& a, const Module& b) { return a.name < b.name; });
+	for (size_t i = 0; i < modules.size(); i++) {
+		const auto& module = modules[i];
+		if (module.code.empty() || module.code[0] != spirvMagic) {
+			spdlog::error("{} is not SPIR-V", module.name);
+			return false;
+		}
+		if (i > 0 && modules[i - 1].name == module.name) {
+			spdlog::error("Two shaders are named {}", module.name);
+			return false;
+		}
+	}
+
+	std::vector<FileEntry> index(modules.size());
+	size_t offset = sizeof(FileHeader) + sizeof(FileEntry) * modules.size();
+	for (size_t i = 0; i < modules.size(); i++) {
+		index[i].nameOffset = static_cast<uint32_t>(offset);
+		index[i].nameSize = static_cast<uint32_t>(modules[i].name.size());
+		offset += modules[i].name.size();
+	}
+	for (size_t i = 0; i < modules.size(); i++) {
+		offset = alignUp(offset, codeAlignment);
+		index[i].codeOffset = static_cast<uint32_t>(offset);
+		index[i].codeSize = static_cast<uint32_t>(modules[i].code.size() * sizeof(uint32_t));
+		offset += index[i].codeSize;
+	}
+	if (offset > UINT32_MAX) {
+		spdlog::error("Shader pack {} would be larger than 4 GiB", path);
+		return false;
+	}
+
+	FileHeader header {};
+	header.magic = fileMagic;
+	header.version = fileVersion;
+	header.count = static_cast<uint32_t>(modules.size());
+	header.fileSize = static_cast<uint32_t>(offset);
+
+	std::vector<std::byte> out(offset);
+	std::memcpy(out.data(), &header, sizeof(header));
+	std::memcpy(out.data() + sizeof(header), index.data(), sizeof(FileEntry) * index.size());
+	for (size_t i = 0; i < modules.size(); i++) {
+		std::memcpy(out.data() + index[i].nameOffset, modules[i].name.data(), index[i].nameSize);
+		std::memcpy(out.data() + index[i].codeOffset, modules[i].code.data(), index[i].codeSize);
+	}
+
+	// Renamed into place, a running engine keeps its mapping of the old pack
+	const auto tmpPath = std::string(path) + ".tmp";
+	const auto file = std::fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		spdlog::error("Failed to open file: {}", tmpPath);
+		return false;
+	}
+	const bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+	if (std::fclose(file) != 0 || !ok || std::rename(tmpPath.c_str(), path) != 0) {
+		spdlog::error("Failed to write file: {}", path);
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
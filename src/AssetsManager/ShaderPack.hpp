@@ -0,0 +1,57 @@
+//
+// Created by ocean on 3/31/22.
+//
+
+#ifndef SHADERPACK_HPP
+#define SHADERPACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VulkanPlayground
+{
+
+/// Every SPIR-V module of the engine in one file, written by the ShaderPacker
+/// tool when the shaders are built. The file is mapped once and modules are
+/// handed out in place, looked up by their source name such as "trig.vert".
+class ShaderPack
+{
+public:
+	struct Module
+	{
+		std::string name;
+		std::vector<uint32_t> code;
+	};
+
+	/// Logs and returns nullptr when the pack is missing or malformed
+	static std::unique_ptr<ShaderPack> open(const char* path);
+	~ShaderPack();
+
+	ShaderPack(const ShaderPack&) = delete;
+	ShaderPack& operator=(const ShaderPack&) = delete;
+
+	/// Empty when there is no such module
+	std::span<const uint32_t> find(std::string_view name) const;
+	size_t size() const { return count_; }
+
+	/// Logs and returns false when a module is not SPIR-V or the file cannot be written
+	static bool write(const char* path, std::vector<Module> modules);
+
+private:
+	ShaderPack(void* map, size_t size);
+	bool validate(const char* path) const;
+	std::string_view name(size_t index) const;
+
+	void* map_ = nullptr;
+	size_t mapSize_ = 0;
+	size_t count_ = 0;
+};
+
+}
+
+#endif //SHADERPACK_HPP
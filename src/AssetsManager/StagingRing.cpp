@@ -0,0 +1,254 @@
+//
+// Created by ocean on 3/22/22.
+//
+
+#include "StagingRing.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+StagingRing::StagingRing(VmaAllocator allocator, vk::Device device, vk::Queue queue, uint32_t queueFamily,
+	vk::DeviceSize capacity)
+	: allocator_(allocator), device_(device), queue_(queue), capacity_(std::bit_ceil(capacity))
+{
+	commandPool_ = device_.createCommandPool({ vk::CommandPoolCreateFlagBits::eTransient, queueFamily });
+
+	const auto bufferCreate = VkBufferCreateInfo {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = capacity_,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+	const VmaAllocationCreateInfo allocCreate = {
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_ONLY,
+		.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	};
+	VkBuffer buffer;
+	VmaAllocationInfo allocInfo;
+	if (vmaCreateBuffer(allocator_, &bufferCreate, &allocCreate, &buffer, &alloc_, &allocInfo) != VK_SUCCESS) {
+		spdlog::error("Failed to create staging buffer");
+		std::terminate();
+	}
+	buffer_ = buffer;
+	mapped_ = static_cast<std::byte *>(allocInfo.pMappedData);
+	VkMemoryPropertyFlags memoryFlags;
+	vmaGetMemoryTypeProperties(allocator_, allocInfo.memoryType, &memoryFlags);
+	hostCached_ = memoryFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+}
+
+StagingRing::~StagingRing()
+{
+	if (recording_)
+		flush();
+	for (const auto& submission : submissions_) {
+		if (device_.waitForFences(1, &submission.fence, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+			spdlog::error("fences not working!");
+		device_.destroy(submission.fence);
+	}
+	for (const auto fence : freeFences_)
+		device_.destroy(fence);
+	device_.destroy(commandPool_);
+	vmaDestroyBuffer(allocator_, buffer_, alloc_);
+}
+
+StagingRing::Region StagingRing::tryReserve(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	if (size == 0 || size > capacity_)
+		return {};
+
+	std::lock_guard lock(mutex_);
+	auto begin = (head_ + alignment - 1) / alignment * alignment;
+	// Never straddle the end of the buffer, skip to the start instead
+	if (begin % capacity_ + size > capacity_)
+		begin = (begin / capacity_ + 1) * capacity_;
+	if (begin + size - tail_ > capacity_)
+		return {};
+
+	allocations_.push_back({begin, begin + size, unrecorded});
+	head_ = begin + size;
+
+	Region region;
+	region.offset = begin % capacity_;
+	region.size = size;
+	region.data = mapped_ + region.offset;
+	region.begin = begin;
+	return region;
+}
+
+StagingRing::Region StagingRing::reserve(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	while (true) {
+		if (const auto region = tryReserve(size, alignment))
+			return region;
+		if (recording_)
+			flush();
+		if (submissions_.empty())
+			return {};
+		waitOldest();
+	}
+}
+
+void StagingRing::cancel(const Region& region)
+{
+	// Already complete, freed with the next collect()
+	consume(region, 0);
+}
+
+vk::CommandBuffer StagingRing::commands()
+{
+	if (!recording_) {
+		recording_ = device_.allocateCommandBuffers({ commandPool_, vk::CommandBufferLevel::ePrimary, 1 }).front();
+		recording_.begin(vk::CommandBufferBeginInfo { vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	}
+	return recording_;
+}
+
+void StagingRing::copyToBuffer(const Region& region, vk::Buffer dst, vk::DeviceSize dstOffset)
+{
+	commands().copyBuffer(buffer_, dst, vk::BufferCopy { region.offset, dstOffset, region.size });
+	copiedBuffers_ = true;
+	consume(region, nextTicket_);
+}
+
+void StagingRing::copyToImage(const Region& region, vk::Image dst, vk::BufferImageCopy copy)
+{
+	copy.bufferOffset += region.offset;
+	commands().copyBufferToImage(buffer_, dst, vk::ImageLayout::eTransferDstOptimal, copy);
+	consume(region, nextTicket_);
+}
+
+bool StagingRing::uploadBuffer(std::span<const std::byte> data, vk::Buffer dst, vk::DeviceSize dstOffset)
+{
+	// Leave room for other users while a large upload cycles through the ring
+	const auto chunk = capacity_ / 4;
+	while (!data.empty()) {
+		const auto size = std::min<vk::DeviceSize>(data.size(), chunk);
+		const auto region = reserve(size);
+		if (!region)
+			return false;
+		std::memcpy(region.data, data.data(), size);
+		copyToBuffer(region, dst, dstOffset);
+		data = data.subspan(size);
+		dstOffset += size;
+	}
+	return true;
+}
+
+bool StagingRing::uploadImage(std::span<const std::byte> pixels, vk::Image dst, vk::Extent3D extent, BlockFormat block,
+	uint32_t mipLevel)
+{
+	const uint32_t blockRows = (extent.height + block.extent - 1) / block.extent;
+	const vk::DeviceSize rowBytes = vk::DeviceSize {(extent.width + block.extent - 1) / block.extent} * block.bytes;
+	const auto rowsPerChunk = static_cast<uint32_t>(std::clamp<vk::DeviceSize>(capacity_ / 4 / rowBytes, 1, blockRows));
+	for (uint32_t row = 0; row < blockRows; row += rowsPerChunk) {
+		const auto rows = std::min(rowsPerChunk, blockRows - row);
+		const auto region = reserve(rowBytes * rows, std::max<vk::DeviceSize>(16, block.bytes));
+		if (!region)
+			return false;
+		std::memcpy(region.data, pixels.data() + rowBytes * row, rowBytes * rows);
+		// The last band may end in a partial block, clipped to the level
+		const auto y = row * block.extent;
+		copyToImage(region, dst, {
+			0, 0, 0,
+			{vk::ImageAspectFlagBits::eColor, mipLevel, 0, 1},
+			{0, static_cast<int32_t>(y), 0},
+			{extent.width, std::min(rows * block.extent, extent.height - y), 1}
+		});
+	}
+	return true;
+}
+
+uint64_t StagingRing::flush()
+{
+	if (!recording_)
+		return nextTicket_ - 1;
+
+	if (copiedBuffers_) {
+		// Images get their own barriers with the layout transition, buffers are
+		// covered once for everything that may read geometry or uniforms
+		const vk::MemoryBarrier barrier {
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead
+				| vk::AccessFlagBits::eUniformRead | vk::AccessFlagBits::eShaderRead
+		};
+		recording_.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader
+				| vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+			{}, barrier, {}, {});
+		copiedBuffers_ = false;
+	}
+	recording_.end();
+
+	vk::Fence fence;
+	if (freeFences_.empty()) {
+		fence = device_.createFence({});
+	} else {
+		fence = freeFences_.back();
+		freeFences_.pop_back();
+	}
+	const vk::SubmitInfo submitInfo { {}, {}, recording_, {} };
+	queue_.submit(submitInfo, fence);
+
+	submissions_.push_back({nextTicket_, recording_, fence});
+	recording_ = nullptr;
+	return nextTicket_++;
+}
+
+void StagingRing::wait(uint64_t ticket)
+{
+	if (ticket >= nextTicket_ && recording_)
+		flush();
+	while (!complete(ticket) && !submissions_.empty())
+		waitOldest();
+}
+
+void StagingRing::waitOldest()
+{
+	const auto fence = submissions_.front().fence;
+	if (device_.waitForFences(1, &fence, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
+		spdlog::error("fences not working!");
+		std::terminate();
+	}
+	collect();
+}
+
+void StagingRing::collect()
+{
+	// Submitted to a single queue, so they complete in order
+	while (!submissions_.empty()) {
+		auto& submission = submissions_.front();
+		if (device_.getFenceStatus(submission.fence) != vk::Result::eSuccess)
+			break;
+		completed_ = submission.ticket;
+		device_.free(commandPool_, submission.cmd);
+		device_.resetFences(submission.fence);
+		freeFences_.push_back(submission.fence);
+		submissions_.pop_front();
+	}
+
+	std::lock_guard lock(mutex_);
+	while (!allocations_.empty() && allocations_.front().ticket <= completed_)
+		allocations_.pop_front();
+	tail_ = allocations_.empty() ? head_ : allocations_.front().begin;
+}
+
+void StagingRing::consume(const Region& region, uint64_t ticket)
+{
+	std::lock_guard lock(mutex_);
+	const auto it = std::lower_bound(allocations_.begin(), allocations_.end(), region.begin,
+		[](const Allocation& a, uint64_t begin) { return a.begin < begin; });
+	if (it == allocations_.end() || it->begin != region.begin) {
+		spdlog::error("Staging region at {} is not reserved", region.offset);
+		std::terminate();
+	}
+	it->ticket = ticket;
+}
+
+}
@@ -0,0 +1,140 @@
+//
+// Created by ocean on 3/22/22.
+//
+
+#ifndef STAGINGRING_HPP
+#define STAGINGRING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_mem_alloc.h"
+#include "TextureFormat.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Engine-wide staging memory for every upload.
+/// One persistently mapped buffer is handed out front to back, wrapping around
+/// at the end. Copies out of it are recorded into a shared command buffer and
+/// submitted by flush(), and a region becomes free again once the fence of the
+/// submission that consumed it has signaled.
+///
+/// Reserving is thread-safe, so loaders can write into staging memory from
+/// worker threads. Recording, flushing and collecting are for the render thread.
+class StagingRing
+{
+public:
+	struct Region
+	{
+		// Into buffer()
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+		std::byte* data = nullptr;
+
+		explicit operator bool() const { return data != nullptr; }
+
+	private:
+		friend StagingRing;
+		// Position in the never wrapping address space of the ring
+		uint64_t begin = 0;
+	};
+
+	/// capacity is rounded up to a power of two
+	StagingRing(VmaAllocator allocator, vk::Device device, vk::Queue queue, uint32_t queueFamily,
+		vk::DeviceSize capacity = 64ull << 20);
+	/// Waits for every upload still in flight
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	/// Returns an empty region when the ring has no room right now
+	Region tryReserve(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+	/// Render thread only. Flushes and waits for earlier uploads until the region fits,
+	/// only fails when the space is held by reservations that were never recorded.
+	Region reserve(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+	/// Hand back a region without copying out of it
+	void cancel(const Region& region);
+
+	/// The command buffer the next flush() submits, begun on first use
+	vk::CommandBuffer commands();
+	void copyToBuffer(const Region& region, vk::Buffer dst, vk::DeviceSize dstOffset);
+	/// bufferOffset of the copy is relative to the region
+	void copyToImage(const Region& region, vk::Image dst, vk::BufferImageCopy copy);
+
+	/// Copy data of any size, split across as many reservations as it takes
+	bool uploadBuffer(std::span<const std::byte> data, vk::Buffer dst, vk::DeviceSize dstOffset);
+	/// Tightly packed texel blocks into a mip level of an image in eTransferDstOptimal,
+	/// split into bands of block rows when they do not fit at once
+	bool uploadImage(std::span<const std::byte> pixels, vk::Image dst, vk::Extent3D extent, BlockFormat block,
+		uint32_t mipLevel = 0);
+
+	/// Submit everything recorded since the last flush, returns the ticket it completes
+	uint64_t flush();
+	bool complete(uint64_t ticket) const { return ticket <= completed_; }
+	void wait(uint64_t ticket);
+	/// Reclaim regions consumed by finished submissions, once per frame
+	void collect();
+
+	vk::Buffer buffer() const { return buffer_; }
+	vk::DeviceSize capacity() const { return capacity_; }
+	/// Whether the mapping is cached, otherwise reading it back is very slow
+	bool hostCached() const { return hostCached_; }
+
+private:
+	// Not recorded into any submission yet
+	static constexpr uint64_t unrecorded = UINT64_MAX;
+
+	struct Allocation
+	{
+		uint64_t begin;
+		uint64_t end;
+		uint64_t ticket;
+	};
+
+	struct Submission
+	{
+		uint64_t ticket;
+		vk::CommandBuffer cmd;
+		vk::Fence fence;
+	};
+
+	void consume(const Region& region, uint64_t ticket);
+	void waitOldest();
+
+	VmaAllocator allocator_;
+	vk::Device device_;
+	vk::Queue queue_;
+	vk::CommandPool commandPool_;
+
+	vk::Buffer buffer_;
+	VmaAllocation alloc_;
+	std::byte* mapped_;
+	vk::DeviceSize capacity_;
+	bool hostCached_;
+
+	// Render thread only
+	vk::CommandBuffer recording_;
+	bool copiedBuffers_ = false;
+	uint64_t nextTicket_ = 1;
+	uint64_t completed_ = 0;
+	std::deque<Submission> submissions_;
+	std::vector<vk::Fence> freeFences_;
+
+	std::mutex mutex_;
+	uint64_t head_ = 0;
+	uint64_t tail_ = 0;
+	// Sorted by begin, the front one pins the tail
+	std::deque<Allocation> allocations_;
+};
+
+}
+
+#endif //STAGINGRING_HPP
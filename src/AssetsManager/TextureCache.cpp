@@ -0,0 +1,235 @@
+//
+// Created by ocean on 3/29/22.
+//
+
+#include "TextureCache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr std::array<char, 4> fileMagic { 'V', 'P', 'T', 'C' };
+constexpr uint32_t fileVersion = 1;
+constexpr auto extension = ".texels";
+
+// Texels start on a cache line
+struct alignas(64) FileHeader
+{
+	std::array<char, 4> magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint64_t content;
+	uint64_t params;
+	uint64_t dataSize;
+};
+
+uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+}
+
+TextureCache::Entry::Entry(void* map, size_t size)
+	: map_(map), size_(size)
+{
+	const auto header = static_cast<const FileHeader *>(map);
+	format = static_cast<vk::Format>(header->format);
+	width = header->width;
+	height = header->height;
+	levels = header->levels;
+	texels = {static_cast<const std::byte *>(map) + sizeof(FileHeader), header->dataSize};
+}
+
+TextureCache::Entry::~Entry()
+{
+	munmap(map_, size_);
+}
+
+TextureCache::TextureCache(std::filesystem::path directory, uint64_t maxBytes)
+	: directory_(std::move(directory)), maxBytes_(maxBytes)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory_, error);
+	if (error) {
+		spdlog::warn("Failed to create texture cache {}: {}", directory_.string(), error.message());
+		return;
+	}
+
+	std::lock_guard lock(mutex_);
+	// Also counts the directory
+	bytes_ = UINT64_MAX;
+	evict();
+}
+
+TextureCache::~TextureCache()
+{
+	const auto s = stats();
+	spdlog::info("Texture cache: {} hits, {} misses, {} stored, {} evicted, {:.1f} MiB on disk",
+		s.hits, s.misses, s.stores, s.evictions, s.bytes / 1048576.0);
+}
+
+TextureCache::Key TextureCache::key(std::span<const uint8_t> source, vk::Format format, bool fullChain)
+{
+	const uint32_t params[] = {fileVersion, static_cast<uint32_t>(format), fullChain};
+	return {
+		fnv1a(source.data(), source.size()),
+		fnv1a(reinterpret_cast<const uint8_t *>(params), sizeof(params))
+	};
+}
+
+std::filesystem::path TextureCache::path(const Key& key) const
+{
+	return directory_ / fmt::format("{:016x}-{:016x}{}", key.content, key.params, extension);
+}
+
+std::shared_ptr<const TextureCache::Entry> TextureCache::find(const Key& key)
+{
+	const auto file = path(key);
+	const auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		misses_++;
+		return nullptr;
+	}
+
+	struct stat st {};
+	void* map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FileHeader))
+		map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		misses_++;
+		return nullptr;
+	}
+
+	const auto header = static_cast<const FileHeader *>(map);
+	if (header->magic != fileMagic || header->version != fileVersion
+		|| header->content != key.content || header->params != key.params
+		|| header->dataSize != static_cast<uint64_t>(st.st_size) - sizeof(FileHeader)) {
+		spdlog::warn("Ignoring corrupt texture cache entry {}", file.string());
+		munmap(map, st.st_size);
+		misses_++;
+		return nullptr;
+	}
+	// The texels are copied out once, read them ahead of the copy
+	madvise(map, st.st_size, MADV_WILLNEED);
+
+	// Most recently used
+	std::error_code error;
+	std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), error);
+	hits_++;
+	return std::make_shared<const Entry>(map, st.st_size);
+}
+
+void TextureCache::store(const Key& key, vk::Format format, uint32_t width, uint32_t height, uint32_t levels,
+	std::span<const std::byte> texels)
+{
+	const auto file = path(key);
+	std::filesystem::path tmpFile;
+	{
+		std::lock_guard lock(mutex_);
+		tmpFile = file;
+		tmpFile += fmt::format(".{}-{}.tmp", getpid(), tmpCounter_++);
+	}
+
+	FileHeader header {};
+	header.magic = fileMagic;
+	header.version = fileVersion;
+	header.format = static_cast<uint32_t>(format);
+	header.width = width;
+	header.height = height;
+	header.levels = levels;
+	header.content = key.content;
+	header.params = key.params;
+	header.dataSize = texels.size();
+
+	const auto out = std::fopen(tmpFile.c_str(), "wb");
+	if (!out) {
+		spdlog::warn("Failed to open file: {}", tmpFile.string());
+		return;
+	}
+	const bool written = std::fwrite(&header, sizeof(header), 1, out) == 1
+		&& std::fwrite(texels.data(), 1, texels.size(), out) == texels.size();
+	std::error_code error;
+	const auto replaced = std::filesystem::file_size(file, error);
+	const auto previous = error ? 0 : replaced;
+	if (std::fclose(out) != 0 || !written || std::rename(tmpFile.c_str(), file.c_str()) != 0) {
+		spdlog::warn("Failed to write texture cache entry {}", file.string());
+		std::remove(tmpFile.c_str());
+		return;
+	}
+
+	std::lock_guard lock(mutex_);
+	bytes_ = bytes_ - std::min<uint64_t>(previous, bytes_) + sizeof(header) + texels.size();
+	stores_++;
+	evict();
+}
+
+void TextureCache::evict()
+{
+	if (bytes_ <= maxBytes_)
+		return;
+
+	struct Candidate
+	{
+		std::filesystem::file_time_type used;
+		std::filesystem::path path;
+		uint64_t size;
+	};
+	std::vector<Candidate> candidates;
+	std::error_code error;
+	// Recount while at it, other runs may share the directory
+	bytes_ = 0;
+	for (const auto& file : std::filesystem::directory_iterator(directory_, error)) {
+		if (file.path().extension() != extension)
+			continue;
+		const auto size = file.file_size(error);
+		const auto used = file.last_write_time(error);
+		if (error)
+			continue;
+		candidates.push_back({used, file.path(), size});
+		bytes_ += size;
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Candidate& a, const Candidate& b) { return a.used < b.used; });
+
+	// Mapped entries stay readable after their file is removed
+	for (const auto& candidate : candidates) {
+		if (bytes_ <= maxBytes_)
+			break;
+		if (std::filesystem::remove(candidate.path, error)) {
+			bytes_ -= candidate.size;
+			evictions_++;
+		}
+	}
+}
+
+TextureCache::Stats TextureCache::stats() const
+{
+	std::lock_guard lock(mutex_);
+	return {hits_, misses_, stores_, evictions_, bytes_};
+}
+
+}
@@ -0,0 +1,110 @@
+//
+// Created by ocean on 3/29/22.
+//
+
+#ifndef TEXTURECACHE_HPP
+#define TEXTURECACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground
+{
+
+/// Decoded texels kept on disk across runs, so an image that has not changed
+/// is mapped and copied instead of decoded again.
+/// Entries are named after a hash of the source file's contents and of the
+/// decode parameters: editing the image or changing how it is decoded simply
+/// misses. The directory is kept under maxBytes by evicting the entries used
+/// least recently, going by modification time, which a hit refreshes.
+///
+/// Thread-safe, lookups and stores happen on the decode workers.
+class TextureCache
+{
+public:
+	struct Key
+	{
+		uint64_t content = 0;
+		uint64_t params = 0;
+	};
+
+	/// A mapped entry, unmapped when the last reference goes
+	class Entry
+	{
+	public:
+		Entry(void* map, size_t size);
+		~Entry();
+
+		Entry(const Entry&) = delete;
+		Entry& operator=(const Entry&) = delete;
+
+		vk::Format format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levels;
+		// Levels back to back, largest first
+		std::span<const std::byte> texels;
+
+	private:
+		void* map_;
+		size_t size_;
+	};
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t stores;
+		uint64_t evictions;
+		// Size of the directory
+		uint64_t bytes;
+	};
+
+	/// The directory is created when missing
+	TextureCache(std::filesystem::path directory, uint64_t maxBytes);
+	/// Logs the counters
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	/// fullChain tells whether every mip level is stored, or only the first
+	static Key key(std::span<const uint8_t> source, vk::Format format, bool fullChain);
+
+	/// nullptr on a miss, including entries that fail validation
+	std::shared_ptr<const Entry> find(const Key& key);
+	/// Written to a temporary file and renamed into place, so concurrent runs
+	/// never map a partial entry. Evicts down to maxBytes afterwards.
+	void store(const Key& key, vk::Format format, uint32_t width, uint32_t height, uint32_t levels,
+		std::span<const std::byte> texels);
+
+	Stats stats() const;
+
+private:
+	std::filesystem::path path(const Key& key) const;
+	// mutex_ held
+	void evict();
+
+	std::filesystem::path directory_;
+	uint64_t maxBytes_;
+
+	std::atomic<uint64_t> hits_ = 0;
+	std::atomic<uint64_t> misses_ = 0;
+
+	mutable std::mutex mutex_;
+	uint64_t bytes_ = 0;
+	uint64_t stores_ = 0;
+	uint64_t evictions_ = 0;
+	uint64_t tmpCounter_ = 0;
+};
+
+}
+
+#endif //TEXTURECACHE_HPP
@@ -0,0 +1,45 @@
+//
+// Created by ocean on 3/27/22.
+//
+
+#include "TextureFormat.hpp"
+
+namespace VulkanPlayground
+{
+
+BlockFormat blockFormat(vk::Format format)
+{
+	using enum vk::Format;
+	switch (format) {
+	case eR8G8B8A8Srgb:
+	case eR8G8B8A8Unorm:
+		return {1, 4};
+	case eBc1RgbSrgbBlock:
+	case eBc1RgbUnormBlock:
+	case eBc1RgbaSrgbBlock:
+	case eBc1RgbaUnormBlock:
+	case eEtc2R8G8B8SrgbBlock:
+	case eEtc2R8G8B8UnormBlock:
+	case eEtc2R8G8B8A1SrgbBlock:
+	case eEtc2R8G8B8A1UnormBlock:
+		return {4, 8};
+	case eBc7SrgbBlock:
+	case eBc7UnormBlock:
+	case eEtc2R8G8B8A8SrgbBlock:
+	case eEtc2R8G8B8A8UnormBlock:
+		return {4, 16};
+	default:
+		return {0, 0};
+	}
+}
+
+size_t imageBytes(vk::Format format, uint32_t width, uint32_t height)
+{
+	const auto block = blockFormat(format);
+	if (!block.extent)
+		return 0;
+	return size_t {(width + block.extent - 1) / block.extent}
+		* ((height + block.extent - 1) / block.extent) * block.bytes;
+}
+
+}
@@ -0,0 +1,30 @@
+//
+// Created by ocean on 3/27/22.
+//
+
+#ifndef TEXTUREFORMAT_HPP
+#define TEXTUREFORMAT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground
+{
+
+/// Texel blocks of a format, 1x1 for uncompressed ones
+struct BlockFormat
+{
+	uint32_t extent;
+	uint32_t bytes;
+};
+
+/// Formats textures can be stored in, an extent of 0 for anything else
+BlockFormat blockFormat(vk::Format format);
+/// Tightly packed size of an image
+size_t imageBytes(vk::Format format, uint32_t width, uint32_t height);
+
+}
+
+#endif //TEXTUREFORMAT_HPP
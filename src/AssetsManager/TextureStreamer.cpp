@@ -0,0 +1,625 @@
+//
+// Created by ocean on 3/18/22.
+//
+
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "stb_image.h"
+
+#include "Ktx2.hpp"
+#include "Mipmaps.hpp"
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr uint32_t placeholderId = UINT32_MAX;
+constexpr auto textureFormat = vk::Format::eR8G8B8A8Srgb;
+
+// What TextureCooker writes, in order of preference: BC7 and ETC2 keep far
+// more detail than BC1, which is the fallback for old desktop hardware
+constexpr std::array cookedFormats = {
+	std::pair {".bc7.ktx2", vk::Format::eBc7SrgbBlock},
+	std::pair {".etc2.ktx2", vk::Format::eEtc2R8G8B8SrgbBlock},
+	std::pair {".bc1.ktx2", vk::Format::eBc1RgbSrgbBlock},
+};
+
+vk::ImageSubresourceRange colorLevels(uint32_t baseLevel, uint32_t count)
+{
+	return {vk::ImageAspectFlagBits::eColor, baseLevel, count, 0, 1};
+}
+
+int32_t mipSize(uint32_t size, uint32_t level)
+{
+	return static_cast<int32_t>(std::max(1u, size >> level));
+}
+
+}
+
+TextureStreamer::TextureStreamer(VmaAllocator allocator, vk::PhysicalDevice gpu, vk::Device device, StagingRing& staging,
+	ThreadPool& pool, TextureCache* cache, BindlessTable* bindless, bool mipmaps, vk::DeviceSize decodeBudget,
+	vk::DeviceSize bytesPerFrame)
+	: allocator_(allocator), gpu_(gpu), device_(device), staging_(staging), bytesPerFrame_(bytesPerFrame),
+	mipmaps_(mipmaps), pool_(pool), cache_(cache), bindless_(bindless), decodeBudget_(decodeBudget)
+{
+	using enum vk::FormatFeatureFlagBits;
+	const auto features = gpu.getFormatProperties(textureFormat).optimalTilingFeatures;
+	blitMips_ = (features & (eBlitSrc | eBlitDst | eSampledImageFilterLinear))
+		== (eBlitSrc | eBlitDst | eSampledImageFilterLinear);
+	if (mipmaps_ && !blitMips_)
+		spdlog::info("Texture format cannot be blitted, generating mips on the CPU");
+
+	for (const auto& [suffix, format] : cookedFormats) {
+		if (sampleable(format)) {
+			cooked_.push_back({suffix, format});
+			spdlog::info("Loading cooked {} textures", vk::to_string(format));
+		}
+	}
+
+	// Mid grey, so a texture popping in is not a flash
+	Decoded placeholder = { .id = placeholderId, .extent = {1, 1, 1} };
+	placeholder.staging = staging_.reserve(4);
+	if (!placeholder.staging) {
+		spdlog::error("Failed to reserve staging memory");
+		std::terminate();
+	}
+	constexpr uint8_t grey[4] = {0x80, 0x80, 0x80, 0xff};
+	std::memcpy(placeholder.staging.data, grey, sizeof(grey));
+	submit({placeholder});
+	staging_.wait(inFlight_.back().ticket);
+	update();
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::unique_lock lock(mutex_);
+		stop_ = true;
+		requests_.clear();
+		idle_.wait(lock, [&] { return decoding_ == 0; });
+	}
+
+	for (const auto& batch : inFlight_) {
+		staging_.wait(batch.ticket);
+		retire(batch);
+	}
+	for (const auto& decoded : decoded_)
+		discard(decoded);
+
+	textures_.push_back(placeholder_);
+	for (const auto& texture : textures_) {
+		if (texture.view)
+			device_.destroy(texture.view);
+		if (texture.image)
+			vmaDestroyImage(allocator_, texture.image, texture.alloc);
+	}
+}
+
+TextureHandle TextureStreamer::load(std::string path)
+{
+	const auto id = static_cast<uint32_t>(textures_.size());
+	textures_.emplace_back();
+	pending_++;
+	if (bindless_)
+		bindless_->set(id, placeholder_.view);
+
+	std::lock_guard lock(mutex_);
+	requests_.push_back({id, std::move(path)});
+	pump();
+	return {id};
+}
+
+std::vector<TextureHandle> TextureStreamer::load(std::span<const std::string> paths)
+{
+	std::vector<TextureHandle> handles;
+	handles.reserve(paths.size());
+	const auto first = static_cast<uint32_t>(textures_.size());
+	textures_.resize(textures_.size() + paths.size());
+	pending_ += paths.size();
+
+	std::lock_guard lock(mutex_);
+	for (uint32_t i = 0; i < paths.size(); i++) {
+		requests_.push_back({first + i, paths[i]});
+		handles.push_back({first + i});
+		if (bindless_)
+			bindless_->set(first + i, placeholder_.view);
+	}
+	pump();
+	return handles;
+}
+
+bool TextureStreamer::ready(TextureHandle texture) const
+{
+	return texture && textures_[texture.id].state == State::Ready;
+}
+
+vk::ImageView TextureStreamer::view(TextureHandle texture) const
+{
+	return ready(texture) ? textures_[texture.id].view : placeholder_.view;
+}
+
+void TextureStreamer::update()
+{
+	std::erase_if(inFlight_, [&](const Batch& batch) {
+		if (!staging_.complete(batch.ticket))
+			return false;
+		retire(batch);
+		return true;
+	});
+
+	std::vector<Decoded> uploads;
+	{
+		std::lock_guard lock(mutex_);
+		for (const auto id : failed_) {
+			textures_[id].state = State::Failed;
+			pending_--;
+		}
+		failed_.clear();
+
+		// Always take at least one, however large
+		vk::DeviceSize bytes = 0;
+		while (!decoded_.empty() && (uploads.empty() || bytes < bytesPerFrame_)) {
+			const auto& next = decoded_.front();
+			bytes += next.bytes;
+			uploads.push_back(next);
+			decoded_.pop_front();
+		}
+	}
+	if (!uploads.empty())
+		submit(std::move(uploads));
+}
+
+void TextureStreamer::pump()
+{
+	// Leave a thread free for other users of the pool, so an urgent job such
+	// as a pipeline compile starts without waiting for a decode to finish
+	const unsigned maxDecoding = pool_.size() > 1 ? pool_.size() - 1 : 1;
+	while (!requests_.empty() && decoding_ < maxDecoding) {
+		auto& next = requests_.front();
+		bool reserved = false;
+		if (next.bytes) {
+			if (budgetUsed_ && budgetUsed_ + next.bytes > decodeBudget_)
+				return;
+			budgetUsed_ += next.bytes;
+			reserved = true;
+		}
+		decoding_++;
+		pool_.post([this, request = std::move(next), reserved]() mutable {
+			decodeJob(std::move(request), reserved);
+		});
+		requests_.pop_front();
+	}
+}
+
+void TextureStreamer::decodeJob(Request request, bool reserved)
+{
+	const auto finish = [&] {
+		decoding_--;
+		if (!stop_)
+			pump();
+		idle_.notify_all();
+	};
+
+	if (!reserved) {
+		const bool known = probe(request);
+
+		std::lock_guard lock(mutex_);
+		if (stop_) {
+			finish();
+			return;
+		}
+		if (!known) {
+			failed_.push_back(request.id);
+			finish();
+			return;
+		}
+		if (budgetUsed_ && budgetUsed_ + request.bytes > decodeBudget_) {
+			// Back to the front of the queue until enough decoded memory is released
+			requests_.push_front(std::move(request));
+			finish();
+			return;
+		}
+		budgetUsed_ += request.bytes;
+	}
+
+	Decoded decoded;
+	const bool ok = decode(request, decoded);
+
+	std::lock_guard lock(mutex_);
+	if (ok) {
+		decoded_.push_back(decoded);
+	} else {
+		budgetUsed_ -= request.bytes;
+		failed_.push_back(request.id);
+	}
+	finish();
+}
+
+bool TextureStreamer::probe(Request& request) const
+{
+	namespace fs = std::filesystem;
+	std::error_code error;
+	const fs::path path = request.path;
+	if (path.extension() == ".ktx2") {
+		request.source = request.path;
+	} else {
+		for (const auto& cooked : cooked_) {
+			auto candidate = path;
+			candidate.replace_extension(cooked.suffix);
+			if (fs::is_regular_file(candidate, error)) {
+				request.source = candidate.string();
+				break;
+			}
+		}
+	}
+
+	if (!request.source.empty()) {
+		// Read whole, the payload is copied out as it is
+		request.bytes = fs::file_size(request.source, error);
+		if (error) {
+			spdlog::error("Failed to load image {}: {}", request.source, error.message());
+			return false;
+		}
+		request.ktx2 = true;
+		return true;
+	}
+
+	request.source = request.path;
+	if (cache_) {
+		// Hashing reads the whole file, decoding it again on a miss comes from the page cache
+		std::ifstream file(request.path, std::ios::binary);
+		const std::vector<uint8_t> contents {std::istreambuf_iterator<char>(file), {}};
+		if (!file.bad() && !contents.empty()) {
+			request.key = TextureCache::key(contents, textureFormat, mipmaps_ && !blitMips_);
+			auto entry = cache_->find(request.key);
+			if (entry && entry->format == textureFormat
+				&& entry->texels.size() == decodedBytes(entry->width, entry->height)) {
+				request.bytes = entry->texels.size();
+				request.cached = std::move(entry);
+				return true;
+			}
+		}
+	}
+
+	int w, h, n;
+	if (!stbi_info(request.path.c_str(), &w, &h, &n)) {
+		spdlog::error("Failed to load image {}: {}", request.path, stbi_failure_reason());
+		return false;
+	}
+	request.width = w;
+	request.height = h;
+	request.bytes = decodedBytes(w, h);
+	return true;
+}
+
+bool TextureStreamer::decode(const Request& request, Decoded& decoded)
+{
+	if (request.ktx2)
+		return loadKtx2(request, decoded);
+	if (request.cached)
+		return loadCached(request, decoded);
+
+	const auto w = request.width;
+	const auto h = request.height;
+	decoded.id = request.id;
+	decoded.extent = vk::Extent3D {w, h, 1u};
+	decoded.levels = mipmaps_ ? mipLevelCount(w, h) : 1;
+	decoded.levelsDecoded = decoded.levels > 1 && !blitMips_ ? decoded.levels : 1;
+	decoded.bytes = request.bytes;
+
+	// Decode straight into staging memory, unless the pixels are read back for
+	// the mip chain or the cache and the mapping is too slow to read from
+	const bool store = cache_ && request.key.content;
+	const bool readBack = decoded.levelsDecoded > 1 || store;
+	std::byte* pixels;
+	if (!readBack || staging_.hostCached()) {
+		pixels = stage(decoded, decoded.bytes);
+	} else {
+		decoded.pixels = std::malloc(decoded.bytes);
+		pixels = static_cast<std::byte *>(decoded.pixels);
+	}
+	if (!pixels) {
+		spdlog::error("Out of memory for {}", request.source);
+		return false;
+	}
+
+	const auto rowPitch = size_t {w} * 4;
+	if (!stbi_load_into(request.source.c_str(), reinterpret_cast<stbi_uc *>(pixels), rowPitch, w, h, STBI_rgb_alpha)) {
+		spdlog::error("Failed to load image {}: {}", request.source, stbi_failure_reason());
+		discard(decoded);
+		return false;
+	}
+	if (decoded.levelsDecoded > 1)
+		generateMipChain(reinterpret_cast<uint8_t *>(pixels), w, h, decoded.levels);
+	if (store) {
+		cache_->store(request.key, textureFormat, w, h, decoded.levelsDecoded,
+			{pixels, static_cast<size_t>(decoded.bytes)});
+	}
+
+	// Decoded off the ring, move it over now if there is room
+	if (!decoded.staging) {
+		decoded.staging = staging_.tryReserve(decoded.bytes);
+		if (decoded.staging) {
+			std::memcpy(decoded.staging.data, pixels, decoded.bytes);
+			std::free(decoded.pixels);
+			decoded.pixels = nullptr;
+		}
+	}
+	return true;
+}
+
+bool TextureStreamer::loadKtx2(const Request& request, Decoded& decoded)
+{
+	Ktx2Texture texture;
+	if (!Ktx2Texture::read(request.source.c_str(), texture))
+		return false;
+	if (!sampleable(texture.format)) {
+		spdlog::error("Failed to load image {}: {} cannot be sampled on this device",
+			request.source, vk::to_string(texture.format));
+		return false;
+	}
+
+	decoded.id = request.id;
+	decoded.extent = vk::Extent3D {texture.width, texture.height, 1u};
+	decoded.format = texture.format;
+	// Cooked chains are complete, never blitted, compressed formats cannot be a blit destination
+	decoded.levels = mipmaps_ ? static_cast<uint32_t>(texture.levels.size()) : 1;
+	decoded.levelsDecoded = decoded.levels;
+	decoded.bytes = request.bytes;
+
+	// Levels are stored smallest first, upload wants them largest first and back to back
+	vk::DeviceSize size = 0;
+	for (uint32_t level = 0; level < decoded.levels; level++)
+		size += texture.levels[level].size;
+	auto out = stage(decoded, size);
+	if (!out) {
+		spdlog::error("Out of memory for {}", request.source);
+		return false;
+	}
+	for (uint32_t level = 0; level < decoded.levels; level++) {
+		const auto& [offset, bytes] = texture.levels[level];
+		std::memcpy(out, texture.data.data() + offset, bytes);
+		out += bytes;
+	}
+	return true;
+}
+
+bool TextureStreamer::loadCached(const Request& request, Decoded& decoded)
+{
+	const auto& entry = *request.cached;
+	decoded.id = request.id;
+	decoded.extent = vk::Extent3D {entry.width, entry.height, 1u};
+	decoded.levels = mipmaps_ ? mipLevelCount(entry.width, entry.height) : 1;
+	decoded.levelsDecoded = entry.levels;
+	decoded.bytes = request.bytes;
+
+	const auto out = stage(decoded, entry.texels.size());
+	if (!out) {
+		spdlog::error("Out of memory for {}", request.source);
+		return false;
+	}
+	std::memcpy(out, entry.texels.data(), entry.texels.size());
+	return true;
+}
+
+std::byte* TextureStreamer::stage(Decoded& decoded, vk::DeviceSize size)
+{
+	decoded.staging = staging_.tryReserve(size);
+	if (decoded.staging)
+		return decoded.staging.data;
+	decoded.pixels = std::malloc(size);
+	return static_cast<std::byte *>(decoded.pixels);
+}
+
+bool TextureStreamer::sampleable(vk::Format format) const
+{
+	const auto features = gpu_.getFormatProperties(format).optimalTilingFeatures;
+	return blockFormat(format).extent
+		&& (features & vk::FormatFeatureFlagBits::eSampledImage)
+		&& (features & vk::FormatFeatureFlagBits::eTransferDst);
+}
+
+vk::DeviceSize TextureStreamer::decodedBytes(uint32_t width, uint32_t height) const
+{
+	if (mipmaps_ && !blitMips_)
+		return mipChainBytes(width, height, mipLevelCount(width, height));
+	return vk::DeviceSize {width} * height * 4;
+}
+
+void TextureStreamer::createImage(Texture& texture, const Decoded& decoded)
+{
+	auto usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+	if (decoded.levelsDecoded < decoded.levels)
+		usage |= vk::ImageUsageFlagBits::eTransferSrc;
+	const auto textureCreate = static_cast<VkImageCreateInfo>(vk::ImageCreateInfo {
+		{},
+		vk::ImageType::e2D,
+		decoded.format,
+		decoded.extent,
+		decoded.levels,
+		1u,
+		vk::SampleCountFlagBits::e1,
+		vk::ImageTiling::eOptimal,
+		usage
+	});
+	const VmaAllocationCreateInfo textureAllocCreate = {
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+		.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+	};
+	VkImage image;
+	if (vmaCreateImage(allocator_, &textureCreate, &textureAllocCreate, &image, &texture.alloc, nullptr) != VK_SUCCESS) {
+		spdlog::error("Failed to create texture buffer");
+		std::terminate();
+	}
+	texture.image = image;
+	texture.view = device_.createImageView({
+		{},
+		texture.image,
+		vk::ImageViewType::e2D,
+		decoded.format,
+		vk::ComponentMapping {},
+		colorLevels(0, decoded.levels)
+	});
+}
+
+void TextureStreamer::submit(std::vector<Decoded> uploads)
+{
+	std::vector<vk::ImageMemoryBarrier> toTransfer;
+	toTransfer.reserve(uploads.size());
+	for (const auto& upload : uploads) {
+		auto& texture = upload.id == placeholderId ? placeholder_ : textures_[upload.id];
+		createImage(texture, upload);
+		toTransfer.push_back({
+			{}, vk::AccessFlagBits::eTransferWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			texture.image, colorLevels(0, upload.levels)
+		});
+	}
+
+	const auto cmd = staging_.commands();
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+		{}, {}, {}, toTransfer);
+	for (size_t i = 0; i < uploads.size(); i++) {
+		auto& upload = uploads[i];
+		const auto image = toTransfer[i].image;
+		vk::DeviceSize offset = 0;
+		for (uint32_t level = 0; level < upload.levelsDecoded; level++) {
+			const vk::Extent3D extent {
+				static_cast<uint32_t>(mipSize(upload.extent.width, level)),
+				static_cast<uint32_t>(mipSize(upload.extent.height, level)),
+				1u
+			};
+			const vk::DeviceSize bytes = imageBytes(upload.format, extent.width, extent.height);
+			if (upload.staging) {
+				staging_.copyToImage(upload.staging, image, {
+					offset, 0, 0,
+					{vk::ImageAspectFlagBits::eColor, level, 0, 1},
+					{0, 0, 0},
+					extent
+				});
+			} else if (!staging_.uploadImage({static_cast<const std::byte *>(upload.pixels) + offset, bytes},
+				image, extent, blockFormat(upload.format), level)) {
+				spdlog::error("Failed to reserve staging memory for texture {}", upload.id);
+				upload.failed = true;
+				break;
+			}
+			offset += bytes;
+		}
+		std::free(upload.pixels);
+		upload.pixels = nullptr;
+	}
+
+	// Uploading in bands may have flushed in between, the rest lands in the last submission
+	blitMips(staging_.commands(), uploads);
+
+	inFlight_.push_back({staging_.flush(), std::move(uploads)});
+}
+
+void TextureStreamer::blitMips(vk::CommandBuffer cmd, const std::vector<Decoded>& uploads)
+{
+	const auto image = [&](const Decoded& upload) {
+		return (upload.id == placeholderId ? placeholder_ : textures_[upload.id]).image;
+	};
+	const auto barrier = [&](const Decoded& upload, uint32_t baseLevel, uint32_t count,
+		vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+		return vk::ImageMemoryBarrier {
+			srcAccess, dstAccess, oldLayout, newLayout,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			image(upload), colorLevels(baseLevel, count)
+		};
+	};
+
+	uint32_t maxLevels = 1;
+	for (const auto& upload : uploads) {
+		if (upload.levelsDecoded < upload.levels)
+			maxLevels = std::max(maxLevels, upload.levels);
+	}
+
+	// One level of every image at a time, so a barrier covers the whole batch
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	for (uint32_t level = 1; level < maxLevels; level++) {
+		barriers.clear();
+		for (const auto& upload : uploads) {
+			if (level >= upload.levelsDecoded && level < upload.levels) {
+				barriers.push_back(barrier(upload, level - 1, 1,
+					vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead,
+					vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal));
+			}
+		}
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+			{}, {}, {}, barriers);
+
+		for (const auto& upload : uploads) {
+			if (level < upload.levelsDecoded || level >= upload.levels)
+				continue;
+			const vk::ImageBlit blit {
+				{vk::ImageAspectFlagBits::eColor, level - 1, 0, 1},
+				{{{0, 0, 0}, {mipSize(upload.extent.width, level - 1), mipSize(upload.extent.height, level - 1), 1}}},
+				{vk::ImageAspectFlagBits::eColor, level, 0, 1},
+				{{{0, 0, 0}, {mipSize(upload.extent.width, level), mipSize(upload.extent.height, level), 1}}}
+			};
+			cmd.blitImage(image(upload), vk::ImageLayout::eTransferSrcOptimal,
+				image(upload), vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+		}
+	}
+
+	// Blit sources are in eTransferSrcOptimal, the last level and copied ones are still in eTransferDstOptimal
+	barriers.clear();
+	for (const auto& upload : uploads) {
+		const auto blitted = upload.levelsDecoded < upload.levels ? upload.levels - 1 : 0;
+		if (blitted) {
+			barriers.push_back(barrier(upload, 0, blitted,
+				vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead,
+				vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal));
+		}
+		barriers.push_back(barrier(upload, blitted, upload.levels - blitted,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal));
+	}
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+		{}, {}, {}, barriers);
+}
+
+void TextureStreamer::retire(const Batch& batch)
+{
+	vk::DeviceSize released = 0;
+	for (const auto& upload : batch.uploads) {
+		released += upload.bytes;
+		// A failed image keeps the placeholder in its place, its contents are undefined
+		const auto state = upload.failed ? State::Failed : State::Ready;
+		if (upload.id == placeholderId) {
+			placeholder_.state = state;
+		} else {
+			textures_[upload.id].state = state;
+			pending_--;
+			if (bindless_ && !upload.failed)
+				bindless_->set(upload.id, textures_[upload.id].view);
+		}
+	}
+	if (released) {
+		std::lock_guard lock(mutex_);
+		budgetUsed_ -= released;
+		if (!stop_)
+			pump();
+	}
+}
+
+void TextureStreamer::discard(const Decoded& decoded)
+{
+	if (decoded.staging)
+		staging_.cancel(decoded.staging);
+	std::free(decoded.pixels);
+}
+
+}
@@ -0,0 +1,208 @@
+//
+// Created by ocean on 3/18/22.
+//
+
+#ifndef TEXTURESTREAMER_HPP
+#define TEXTURESTREAMER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vk_mem_alloc.h"
+#include "BindlessTable.hpp"
+#include "StagingRing.hpp"
+#include "TextureCache.hpp"
+#include "ThreadPool.hpp"
+
+namespace VulkanPlayground
+{
+
+struct TextureHandle
+{
+	uint32_t id = UINT32_MAX;
+
+	explicit operator bool() const { return id != UINT32_MAX; }
+};
+
+/// Loads textures without blocking the caller or the device.
+/// Files are decoded in parallel on the thread pool straight into the staging
+/// ring, with no intermediate copy of the pixels. The render thread then
+/// records the copies for everything decoded so far, in the order decoding
+/// finished, with batched layout transitions, and flushes them as one
+/// submission.
+/// Until that submission completes, view() hands out a placeholder.
+///
+/// Textures get a full mip chain, blitted on the GPU when the device can
+/// linearly filter the format, otherwise filtered on the worker after decoding.
+///
+/// A texture cooked by TextureCooker next to the requested file, such as
+/// brick.bc7.ktx2 for brick.jpg, is loaded instead of decoding the original
+/// when the device can sample its format. KTX2 files can also be loaded directly.
+///
+/// With a TextureCache, decoded images are written to it and later loads of an
+/// unchanged file are copied from the mapped entry without decoding.
+///
+/// With a BindlessTable, TextureHandle::id is the texture's slot in it. The
+/// slot holds the placeholder from load() on and the texture once uploaded.
+class TextureStreamer
+{
+public:
+	/// Decoded pixels held in memory, from the start of decoding until the copy
+	/// has completed, are kept under decodeBudget. A single image larger than the
+	/// budget is still loaded, on its own.
+	/// At most bytesPerFrame of them are submitted per update(), so loading many
+	/// textures at once is spread over several frames.
+	/// cache and bindless may be null.
+	TextureStreamer(VmaAllocator allocator, vk::PhysicalDevice gpu, vk::Device device, StagingRing& staging,
+		ThreadPool& pool, TextureCache* cache, BindlessTable* bindless, bool mipmaps = true,
+		vk::DeviceSize decodeBudget = 256ull << 20, vk::DeviceSize bytesPerFrame = 32ull << 20);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	/// Queue a file for loading, the handle is valid immediately.
+	/// Render thread only, like update().
+	TextureHandle load(std::string path);
+	/// Queue many files at once, they are decoded as many at a time as the pool
+	/// has threads and the budget allows
+	std::vector<TextureHandle> load(std::span<const std::string> paths);
+
+	/// Called once per frame: retires finished uploads and submits newly decoded ones
+	void update();
+
+	bool ready(TextureHandle texture) const;
+	/// The texture once its upload has completed, the placeholder before that
+	/// or when loading failed
+	vk::ImageView view(TextureHandle texture) const;
+	vk::ImageView placeholder() const { return placeholder_.view; }
+	/// Textures requested but not yet ready
+	size_t pending() const { return pending_; }
+
+private:
+	enum class State
+	{
+		Loading,
+		Ready,
+		Failed,
+	};
+
+	struct Texture
+	{
+		vk::Image image;
+		VmaAllocation alloc = nullptr;
+		vk::ImageView view;
+		State state = State::Loading;
+	};
+
+	struct Request
+	{
+		uint32_t id;
+		std::string path;
+		// Decoded size, 0 until the header has been read
+		vk::DeviceSize bytes = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// The file actually read, a KTX2 one when cooked
+		std::string source;
+		bool ktx2 = false;
+		// Set when the cache is used, cached on a hit
+		TextureCache::Key key;
+		std::shared_ptr<const TextureCache::Entry> cached;
+	};
+
+	struct CookedFormat
+	{
+		const char* suffix;
+		vk::Format format;
+	};
+
+	// Pixels waiting for a transfer
+	struct Decoded
+	{
+		uint32_t id;
+		vk::Extent3D extent;
+		vk::Format format = vk::Format::eR8G8B8A8Srgb;
+		uint32_t levels = 1;
+		// Levels present in the pixels, the rest are blitted from the first
+		uint32_t levelsDecoded = 1;
+		// Charged against the decode budget
+		vk::DeviceSize bytes = 0;
+		// In the staging ring, or in malloc'd memory when the ring had no
+		// room, to be uploaded in bands by the render thread
+		StagingRing::Region staging;
+		void* pixels = nullptr;
+		// A level could not be staged, the image was never fully written
+		bool failed = false;
+	};
+
+	struct Batch
+	{
+		uint64_t ticket;
+		std::vector<Decoded> uploads;
+	};
+
+	// Hand queued requests to the pool while threads and budget allow, mutex_ held
+	void pump();
+	void decodeJob(Request request, bool reserved);
+	// Pick the file to read and size it, false when there is nothing loadable
+	bool probe(Request& request) const;
+	bool decode(const Request& request, Decoded& decoded);
+	bool loadKtx2(const Request& request, Decoded& decoded);
+	bool loadCached(const Request& request, Decoded& decoded);
+	// Room for the texels of decoded in the staging ring, or on the heap when it is full
+	std::byte* stage(Decoded& decoded, vk::DeviceSize size);
+	bool sampleable(vk::Format format) const;
+	// Pixels the decoder hands over for an image of this size
+	vk::DeviceSize decodedBytes(uint32_t width, uint32_t height) const;
+	void createImage(Texture& texture, const Decoded& decoded);
+	// Fill the levels after the first, recorded for a whole batch at once
+	void blitMips(vk::CommandBuffer cmd, const std::vector<Decoded>& uploads);
+	void submit(std::vector<Decoded> uploads);
+	void retire(const Batch& batch);
+	void discard(const Decoded& decoded);
+
+	VmaAllocator allocator_;
+	vk::PhysicalDevice gpu_;
+	vk::Device device_;
+	StagingRing& staging_;
+	vk::DeviceSize bytesPerFrame_;
+	bool mipmaps_;
+	bool blitMips_;
+	// Cooked variants the device can sample, most preferred first
+	std::vector<CookedFormat> cooked_;
+
+	Texture placeholder_;
+	// Indexed by TextureHandle::id, only touched by the render thread
+	std::vector<Texture> textures_;
+	size_t pending_ = 0;
+
+	std::vector<Batch> inFlight_;
+
+	ThreadPool& pool_;
+	TextureCache* cache_;
+	BindlessTable* bindless_;
+	vk::DeviceSize decodeBudget_;
+
+	// Shared with the decode jobs
+	std::mutex mutex_;
+	std::condition_variable idle_;
+	std::deque<Request> requests_;
+	std::deque<Decoded> decoded_;
+	std::vector<uint32_t> failed_;
+	vk::DeviceSize budgetUsed_ = 0;
+	unsigned decoding_ = 0;
+	bool stop_ = false;
+};
+
+}
+
+#endif //TEXTURESTREAMER_HPP
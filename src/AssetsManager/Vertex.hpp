@@ -5,31 +5,73 @@
 #ifndef VERTEX_HPP
 #define VERTEX_HPP
 
-#include <array>
-
 #include <glm/glm.hpp>
-#include <vulkan/vulkan.hpp>
+
+#include "VertexLayout.hpp"
 
 namespace VulkanPlayground
 {
 
+/// Vertex buffers of the GeometryStore, each holds one vertex type at binding 0
+enum class VertexStream
+{
+	// Vertex, the quad and other 2D meshes
+	Quad,
+	// MeshVertex, meshes mapped from a MeshFile
+	Mesh,
+};
+
 struct Vertex
 {
-	glm::vec2 pos;
-	glm::vec3 color;
-
-	constexpr static vk::VertexInputBindingDescription vertexInputBinding = {
-		0, 5 * sizeof(float), vk::VertexInputRate::eVertex
-	};
-
-	constexpr static std::array<vk::VertexInputAttributeDescription,2> vertexInputAttribute = {
-		vk::VertexInputAttributeDescription {
-			0, 0, vk::Format::eR32G32Sfloat, 0
-		},
-		vk::VertexInputAttributeDescription {
-			1, 0, vk::Format::eR32G32B32Sfloat, 2 * sizeof(float)
-		}
-	};
+	Half2 pos;
+	Half2 uv;
+};
+
+template<>
+struct VertexInput<Vertex>
+{
+	constexpr static auto layout = vertexLayout<Vertex>(0, vk::VertexInputRate::eVertex, 0,
+		VERTEX_ATTRIBUTE(Vertex, pos),
+		VERTEX_ATTRIBUTE(Vertex, uv));
+};
+
+/// Per instance data of a sprite, drawn on the quad mesh
+struct SpriteInstance
+{
+	glm::vec2 position;
+	glm::vec2 scale;
+	// Offset and size of the sampled part of the texture
+	glm::vec4 uvRect = {0.0f, 0.0f, 1.0f, 1.0f};
+};
+
+template<>
+struct VertexInput<SpriteInstance>
+{
+	constexpr static auto layout = vertexLayout<SpriteInstance>(1, vk::VertexInputRate::eInstance, 2,
+		VERTEX_ATTRIBUTE(SpriteInstance, position),
+		VERTEX_ATTRIBUTE(SpriteInstance, scale),
+		VERTEX_ATTRIBUTE(SpriteInstance, uvRect));
+};
+
+/// Per instance data of an object of the GpuScene, written by the culling pass
+struct SceneInstance
+{
+	glm::vec2 position;
+	glm::vec2 scale;
+	glm::vec4 uvRect;
+	// Slot in the bindless table
+	uint32_t texture;
+	uint32_t padding[3];
+};
+
+template<>
+struct VertexInput<SceneInstance>
+{
+	constexpr static auto layout = vertexLayout<SceneInstance>(1, vk::VertexInputRate::eInstance, 2,
+		VERTEX_ATTRIBUTE(SceneInstance, position),
+		VERTEX_ATTRIBUTE(SceneInstance, scale),
+		VERTEX_ATTRIBUTE(SceneInstance, uvRect),
+		VERTEX_ATTRIBUTE(SceneInstance, texture));
 };
 
 }
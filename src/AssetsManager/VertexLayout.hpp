@@ -0,0 +1,222 @@
+//
+// Created by ocean on 4/9/22.
+//
+
+#ifndef VERTEXLAYOUT_HPP
+#define VERTEXLAYOUT_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground
+{
+
+// Packed attribute types, the shader reads them as floats. Components are
+// stored in order, so the first is at the lowest address.
+
+/// Two half floats, read as a vec2
+struct Half2
+{
+	std::array<uint16_t, 2> bits;
+};
+
+/// Four half floats, read as a vec4
+struct Half4
+{
+	std::array<uint16_t, 4> bits;
+};
+
+/// Two signed normalized 16 bit values, read as a vec2 in [-1, 1]
+struct Snorm16x2
+{
+	std::array<int16_t, 2> values;
+};
+
+/// Four signed normalized 16 bit values, read as a vec4 in [-1, 1]
+struct Snorm16x4
+{
+	std::array<int16_t, 4> values;
+};
+
+/// Four unsigned normalized bytes, read as a vec4 in [0, 1]
+struct Unorm8x4
+{
+	std::array<uint8_t, 4> values;
+};
+
+/// Three 10 bit and one 2 bit unsigned normalized values, x in the low bits
+struct Unorm1010102
+{
+	uint32_t bits;
+};
+
+/// Three 10 bit and one 2 bit signed normalized values, x in the low bits.
+/// Devices are not required to read it from vertex buffers, though every
+/// current desktop GPU does.
+struct Snorm1010102
+{
+	uint32_t bits;
+};
+
+/// Rounds to the nearest half, overflowing to infinity
+constexpr uint16_t packHalf(float v)
+{
+	const auto bits = std::bit_cast<uint32_t>(v);
+	const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const auto biased = static_cast<int32_t>((bits >> 23) & 0xff);
+	auto mantissa = bits & 0x7fffff;
+	if (biased == 0xff)
+		return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+	const auto exponent = biased - 127 + 15;
+	if (exponent >= 31)
+		return sign | 0x7c00;
+	// Ties go to even, a carry out of the mantissa moves to the next exponent
+	const auto round = [](uint32_t value, uint32_t shift) {
+		const auto rest = value & ((1u << shift) - 1);
+		const auto halfway = 1u << (shift - 1);
+		value >>= shift;
+		return value + (rest > halfway || (rest == halfway && (value & 1)));
+	};
+	if (exponent <= 0) {
+		// Denormal, or zero once the mantissa is shifted out
+		if (exponent < -10)
+			return sign;
+		return sign | static_cast<uint16_t>(round(mantissa | 0x800000, 14 - exponent));
+	}
+	return sign | static_cast<uint16_t>(round((static_cast<uint32_t>(exponent) << 23) | mantissa, 13));
+}
+
+/// v clamped to [-1, 1] and scaled to [-max, max]
+constexpr int32_t packSnorm(float v, int32_t max)
+{
+	const auto scaled = std::clamp(v, -1.0f, 1.0f) * static_cast<float>(max);
+	return static_cast<int32_t>(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+/// v clamped to [0, 1] and scaled to [0, max]
+constexpr uint32_t packUnorm(float v, uint32_t max)
+{
+	return static_cast<uint32_t>(std::clamp(v, 0.0f, 1.0f) * static_cast<float>(max) + 0.5f);
+}
+
+constexpr Half2 packHalf2(glm::vec2 v)
+{
+	return {{packHalf(v.x), packHalf(v.y)}};
+}
+
+constexpr Half4 packHalf4(glm::vec4 v)
+{
+	return {{packHalf(v.x), packHalf(v.y), packHalf(v.z), packHalf(v.w)}};
+}
+
+constexpr Snorm16x2 packSnorm16x2(glm::vec2 v)
+{
+	return {{static_cast<int16_t>(packSnorm(v.x, 32767)), static_cast<int16_t>(packSnorm(v.y, 32767))}};
+}
+
+constexpr Snorm16x4 packSnorm16x4(glm::vec4 v)
+{
+	return {{
+		static_cast<int16_t>(packSnorm(v.x, 32767)), static_cast<int16_t>(packSnorm(v.y, 32767)),
+		static_cast<int16_t>(packSnorm(v.z, 32767)), static_cast<int16_t>(packSnorm(v.w, 32767))
+	}};
+}
+
+constexpr Unorm8x4 packUnorm8x4(glm::vec4 v)
+{
+	return {{
+		static_cast<uint8_t>(packUnorm(v.x, 255)), static_cast<uint8_t>(packUnorm(v.y, 255)),
+		static_cast<uint8_t>(packUnorm(v.z, 255)), static_cast<uint8_t>(packUnorm(v.w, 255))
+	}};
+}
+
+constexpr Unorm1010102 packUnorm1010102(glm::vec4 v)
+{
+	return {packUnorm(v.x, 1023) | packUnorm(v.y, 1023) << 10 | packUnorm(v.z, 1023) << 20 | packUnorm(v.w, 3) << 30};
+}
+
+/// Two's complement in every field, w is -1, 0 or 1
+constexpr Snorm1010102 packSnorm1010102(glm::vec4 v)
+{
+	const auto field = [](float value, int32_t max, uint32_t mask) {
+		return static_cast<uint32_t>(packSnorm(value, max)) & mask;
+	};
+	return {field(v.x, 511, 0x3ff) | field(v.y, 511, 0x3ff) << 10 | field(v.z, 511, 0x3ff) << 20
+		| field(v.w, 1, 0x3) << 30};
+}
+
+/// Format the vertex input reads a member of type T as. Not defined for
+/// types without one, so a member nothing can read fails to compile.
+template<typename T>
+struct VertexFormat;
+
+template<> struct VertexFormat<float> { constexpr static auto value = vk::Format::eR32Sfloat; };
+template<> struct VertexFormat<glm::vec2> { constexpr static auto value = vk::Format::eR32G32Sfloat; };
+template<> struct VertexFormat<glm::vec3> { constexpr static auto value = vk::Format::eR32G32B32Sfloat; };
+template<> struct VertexFormat<glm::vec4> { constexpr static auto value = vk::Format::eR32G32B32A32Sfloat; };
+template<> struct VertexFormat<uint32_t> { constexpr static auto value = vk::Format::eR32Uint; };
+template<> struct VertexFormat<int32_t> { constexpr static auto value = vk::Format::eR32Sint; };
+template<> struct VertexFormat<Half2> { constexpr static auto value = vk::Format::eR16G16Sfloat; };
+template<> struct VertexFormat<Half4> { constexpr static auto value = vk::Format::eR16G16B16A16Sfloat; };
+template<> struct VertexFormat<Snorm16x2> { constexpr static auto value = vk::Format::eR16G16Snorm; };
+template<> struct VertexFormat<Snorm16x4> { constexpr static auto value = vk::Format::eR16G16B16A16Snorm; };
+template<> struct VertexFormat<Unorm8x4> { constexpr static auto value = vk::Format::eR8G8B8A8Unorm; };
+template<> struct VertexFormat<Unorm1010102> { constexpr static auto value = vk::Format::eA2B10G10R10UnormPack32; };
+template<> struct VertexFormat<Snorm1010102> { constexpr static auto value = vk::Format::eA2B10G10R10SnormPack32; };
+
+struct VertexAttribute
+{
+	vk::Format format;
+	uint32_t offset;
+};
+
+/// Attribute read from V::member, with the format of its type. offsetof only
+/// takes the member by name, hence the macro.
+#define VERTEX_ATTRIBUTE(V, member) \
+	::VulkanPlayground::VertexAttribute { \
+		::VulkanPlayground::VertexFormat<decltype(V::member)>::value, static_cast<uint32_t>(offsetof(V, member)) \
+	}
+
+template<size_t N>
+struct VertexLayout
+{
+	vk::VertexInputBindingDescription binding;
+	std::array<vk::VertexInputAttributeDescription, N> attributes;
+};
+
+/// Binding of V with a stride of sizeof(V), and its attributes at consecutive
+/// locations from firstLocation, in the order they are given
+template<typename V, typename... Attributes>
+constexpr VertexLayout<sizeof...(Attributes)> vertexLayout(uint32_t binding, vk::VertexInputRate rate,
+	uint32_t firstLocation, Attributes... attributes)
+{
+	static_assert(std::is_standard_layout_v<V>, "offsetof is only defined for standard layout types");
+	static_assert((std::is_same_v<Attributes, VertexAttribute> && ...));
+	const std::array<VertexAttribute, sizeof...(Attributes)> list {attributes...};
+	return [&]<size_t... I>(std::index_sequence<I...>) {
+		return VertexLayout<sizeof...(Attributes)> {
+			{binding, sizeof(V), rate},
+			{vk::VertexInputAttributeDescription {
+				static_cast<uint32_t>(firstLocation + I), binding, list[I].format, list[I].offset
+			}...}
+		};
+	}(std::make_index_sequence<sizeof...(Attributes)>());
+}
+
+/// Vertex input of V, specialized next to every vertex type with a layout
+/// member built by vertexLayout
+template<typename V>
+struct VertexInput;
+
+}
+
+#endif //VERTEXLAYOUT_HPP
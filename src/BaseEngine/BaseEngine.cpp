@@ -4,13 +4,9 @@
 
 #include "BaseEngine.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
-#ifdef __GLIBCXX__
-#include <bits/this_thread_sleep.h>
-#else
-#include <thread>
-#endif
 #include <vector>
 #include <stdexcept>
 
@@ -25,40 +21,70 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 namespace VulkanPlayground
 {
 
-BaseEngine::BaseEngine()
+BaseEngine::BaseEngine(const EngineConfig& config)
+	: config_(config),
+	pacer_(config.headless ? PacingPolicy::Uncapped : config.pacing, config.targetFps),
+	threadPool_(std::make_unique<ThreadPool>(config.workerThreads)),
+	shaders_(ShaderPack::open(config.shaderPackPath.c_str()))
 {
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
+	// Nothing renders without it
+	if (!shaders_)
+		std::terminate();
+	if (config_.shaderHotReload)
+		shaderWatcher_ = std::make_unique<ShaderWatcher>(config_.shaderPackPath);
+
+	const bool headless = config_.headless;
+	winSize_ = config_.extent;
+
+	// Headless nodes have no display, only the event subsystem is needed for SDL_QUIT
+	if (SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
 		spdlog::error("Failed to initialize SDL: {}", SDL_GetError());
 		std::terminate();
 	}
-	if (SDL_Vulkan_LoadLibrary(nullptr) < 0) {
-		spdlog::error("Failed to load vulkan loader: {}", SDL_GetError());
-	}
 
-	auto vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)SDL_Vulkan_GetVkGetInstanceProcAddr();
+	PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+	if (headless) {
+		try {
+			loader_ = std::make_unique<vk::DynamicLoader>();
+		} catch (const std::runtime_error& e) {
+			spdlog::error("Failed to load vulkan loader: {}", e.what());
+			std::terminate();
+		}
+		vkGetInstanceProcAddr = loader_->getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
+	} else {
+		if (SDL_Vulkan_LoadLibrary(nullptr) < 0) {
+			spdlog::error("Failed to load vulkan loader: {}", SDL_GetError());
+		}
+		vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)SDL_Vulkan_GetVkGetInstanceProcAddr();
+	}
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
-	window_ = SDL_CreateWindow("Hello?",
-		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-		winSize_[0], winSize_[1],
-		SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+	std::vector<const char*> instanceExtensions;
+	if (!headless) {
+		window_ = SDL_CreateWindow("Hello?",
+			SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+			winSize_[0], winSize_[1],
+			SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
-	if (!window_) {
-		spdlog::error("Failed to create SDL window: {}", SDL_GetError());
-		std::terminate();
-	}
+		if (!window_) {
+			spdlog::error("Failed to create SDL window: {}", SDL_GetError());
+			std::terminate();
+		}
 
-	unsigned count;
-	if(!SDL_Vulkan_GetInstanceExtensions(window_, &count, nullptr)) {
-		spdlog::error("Failed to query required vulkan instance extensions: {}", SDL_GetError());
-		std::terminate();
+		unsigned count;
+		if(!SDL_Vulkan_GetInstanceExtensions(window_, &count, nullptr)) {
+			spdlog::error("Failed to query required vulkan instance extensions: {}", SDL_GetError());
+			std::terminate();
+		}
+		instanceExtensions.resize(count);
+		SDL_Vulkan_GetInstanceExtensions(window_, &count, instanceExtensions.data());
 	}
-	std::vector<const char*> instanceExtensions(count);
-	SDL_Vulkan_GetInstanceExtensions(window_, &count, instanceExtensions.data());
 
-	// TODO: Make GPU debug optional
-	instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-	std::array<const char*, 1> explicitLayers { "VK_LAYER_KHRONOS_validation" };
+	std::vector<const char*> explicitLayers;
+	if (config_.validation) {
+		instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		explicitLayers.push_back("VK_LAYER_KHRONOS_validation");
+	}
 
 	vk::ApplicationInfo appInfo(
 		"Hello?", VK_MAKE_VERSION(0, 1, 0),
@@ -83,12 +109,18 @@ BaseEngine::BaseEngine()
 			Debug::VulkanDebugCallback
 		}
 	};
+	if (!config_.validation)
+		instance.unlink<vk::DebugUtilsMessengerCreateInfoEXT>();
 
 	instance_ = vk::createInstance(instance.get());
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(instance_);
 
 	// template type inference in C++ is awful
-	debugMsg_ = instance_.createDebugUtilsMessengerEXT(instance.get<vk::DebugUtilsMessengerCreateInfoEXT>());
+	if (config_.validation)
+		debugMsg_ = instance_.createDebugUtilsMessengerEXT(instance.get<vk::DebugUtilsMessengerCreateInfoEXT>());
+
+	if (headless)
+		return;
 
 	VkSurfaceKHR SDLSurface; // Workaround that SDL only accept C vulkan construct
 	if(!SDL_Vulkan_CreateSurface(window_, instance_, &SDLSurface)) {
@@ -101,15 +133,27 @@ BaseEngine::BaseEngine()
 BaseEngine::~BaseEngine()
 {
 	presenter_.reset(nullptr);
-	for (auto& syncObj : syncObjs_) {
-		auto [sem1, sem2, fence] = syncObj;
-		device_.destroy(fence);
-		device_.destroy(sem2);
-		device_.destroy(sem1);
+	// Waits for compiles still using the pipeline cache and reloaded shaders
+	pipelines_.reset();
+	reloadedShaders_.reset();
+	if (pipelineCache_) {
+		pipelineCache_->save();
+		pipelineCache_.reset();
 	}
-	for (auto& t : texture_)
-		t.destroy();
-	vmaDestroyBuffer(vma_, view_, viewAlloc_);
+	for (auto& frame : frames_) {
+		device_.destroy(frame.frameDone);
+		device_.destroy(frame.imageAvailable);
+		device_.destroy(frame.cmdPool);
+	}
+	profiler_.reset();
+	scene_.reset();
+	geometry_.reset();
+	textures_.reset();
+	bindless_.reset();
+	textureCache_.reset();
+	threadPool_.reset();
+	staging_.reset();
+	frameArena_.reset();
 	device_.destroy(renderPass_);
 	device_.destroy(globalPipelineLayout_);
 	device_.destroy(graphicsCmdPool_);
@@ -118,8 +162,11 @@ BaseEngine::~BaseEngine()
 	device_.destroy(globalDescriptorLayout_);
 	vmaDestroyAllocator(vma_);
 	device_.destroy();
-	instance_.destroy(surface_);
-	instance_.destroy(debugMsg_);
+	// Extension entry points are not loaded when the extension is not enabled
+	if (surface_)
+		instance_.destroy(surface_);
+	if (debugMsg_)
+		instance_.destroy(debugMsg_);
 	instance_.destroy();
 
 	if (window_)
@@ -127,6 +174,20 @@ BaseEngine::~BaseEngine()
 	SDL_Quit();
 }
 
+bool BaseEngine::renderFrame()
+{
+	reloadShaders();
+	if (presenter_->Run() == Presenter::FrameResult::Presented)
+		return false;
+	initPresenter();
+	return true;
+}
+
+const FrameTimings& BaseEngine::frameTimings() const
+{
+	return presenter_->timings_;
+}
+
 void BaseEngine::run()
 {
 	if (!presenter_) {
@@ -135,12 +196,16 @@ void BaseEngine::run()
 	}
 	SDL_Event event;
 
-	using namespace std::chrono_literals;
-	auto lastframe = std::chrono::steady_clock::now();
-	constexpr auto targettime = 16.667ms;
+	// A window drag sends a resize event every frame. While the old swapchain
+	// can still present, the targets are rebuilt once the size has settled
+	// rather than for every one of them.
+	constexpr auto resizeSettle = std::chrono::milliseconds(100);
 	bool resized = false;
+	bool outOfDate = false;
+	auto lastResize = std::chrono::steady_clock::time_point {};
+	uint64_t frames = 0;
 
-	while (true) {
+	while (config_.maxFrames == 0 || frames < config_.maxFrames) {
 		while (SDL_PollEvent(&event)) {
 			switch (event.type) {
 			case SDL_QUIT:
@@ -149,7 +214,7 @@ void BaseEngine::run()
 				switch (event.window.event) {
 					case SDL_WINDOWEVENT_RESIZED:
 						winSize_ = {event.window.data1, event.window.data2};
-						lastframe = std::chrono::steady_clock::now();
+						lastResize = std::chrono::steady_clock::now();
 						resized = true;
 				}
 				break;
@@ -162,8 +227,10 @@ void BaseEngine::run()
 			}
 		}
 
-		auto windowflags = SDL_GetWindowFlags(window_);
-		if (windowflags & SDL_WINDOW_MINIMIZED) continue;
+		if (window_) {
+			auto windowflags = SDL_GetWindowFlags(window_);
+			if (windowflags & SDL_WINDOW_MINIMIZED) continue;
+		}
 
 		if (arrowKey_[SDL_SCANCODE_DOWN]) modelCenter_[1] -= 5;
 		if (arrowKey_[SDL_SCANCODE_UP]) modelCenter_[1] += 5;
@@ -172,23 +239,87 @@ void BaseEngine::run()
 		modelCenter_[0] = std::clamp(modelCenter_[0], -100, 100);
 		modelCenter_[1] = std::clamp(modelCenter_[1], -100, 100);
 
-		auto now = std::chrono::steady_clock::now();
-		if (resized) {
-			if ((now - lastframe) < 100ms) {
-				continue;
-			} else {
-				initPresenter();
-			}
+		// Nothing to throttle against without a compositor, go at device speed
+		if (config_.headless) {
+			pacer_.wait();
+			reloadShaders();
+			presenter_->Run();
+			frames++;
+			continue;
 		}
-		while ((now = std::chrono::steady_clock::now()) - lastframe < targettime);
-		lastframe = now;
 
-		resized = presenter_->Run();
+		// Nothing can be presented until an out of date swapchain is rebuilt,
+		// a suboptimal one still presents, scaled by the compositor
+		if (outOfDate || (resized && std::chrono::steady_clock::now() - lastResize >= resizeSettle)) {
+			initPresenter();
+			resized = outOfDate = false;
+		}
+		pacer_.wait();
+
+		reloadShaders();
+		const auto result = presenter_->Run();
+		outOfDate = result == Presenter::FrameResult::OutOfDate;
+		resized |= result == Presenter::FrameResult::Suboptimal;
+		frames++;
+	}
+}
 
-		if (!resized) {
-			std::this_thread::sleep_until(lastframe + 15.55ms);
+void BaseEngine::reloadShaders()
+{
+	if (!shaderWatcher_)
+		return;
+	if (shaderWatcher_->changed())
+		shadersChanged_ = true;
+
+	if (shaderReload_[0].valid()) {
+		const auto ready = std::all_of(shaderReload_.begin(), shaderReload_.end(), [](const auto& pipeline) {
+			return !pipeline.valid() || pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		});
+		if (!ready)
+			return;
+		std::array<vk::Pipeline, 4> pipelines;
+		for (size_t i = 0; i < pipelines.size(); i++) {
+			if (shaderReload_[i].valid())
+				pipelines[i] = shaderReload_[i].get();
 		}
+		const bool compiled = pipelines[0] && pipelines[1] && (!scene_ || pipelines[2]) && (!mesh_ || pipelines[3]);
+		shaderReload_ = {};
+		// A failed reload keeps the old pipelines drawing
+		if (compiled) {
+			presenter_->replacePipelines(pipelines[0], pipelines[1], pipelines[2], pipelines[3]);
+			shaders_ = std::move(reloadedShaders_);
+			spdlog::info("Reloaded shaders in {:.1f} ms",
+				std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reloadStart_).count());
+		} else {
+			spdlog::warn("Keeping the old pipelines after a failed shader reload");
+		}
+		reloadedShaders_.reset();
+	}
+	if (!shadersChanged_)
+		return;
+
+	// One reload at a time, a change meanwhile starts another once it is done
+	shadersChanged_ = false;
+	reloadStart_ = std::chrono::steady_clock::now();
+	// Mapping the pack is cheap, only the compile goes to the workers
+	reloadedShaders_ = ShaderPack::open(config_.shaderPackPath.c_str());
+	if (!reloadedShaders_) {
+		spdlog::warn("Keeping the old pipelines after a failed shader reload");
+		return;
 	}
+	shaderReload_ = compilePipelines(*reloadedShaders_);
+}
+
+BaseEngine::Pipelines BaseEngine::compilePipelines(const ShaderPack& shaders) const
+{
+	Pipelines pipelines;
+	pipelines[0] = pipelines_->compile(quadPipeline(), shaders);
+	pipelines[1] = pipelines_->compile(spritePipeline(), shaders);
+	if (scene_)
+		pipelines[2] = pipelines_->compile(scenePipeline(), shaders);
+	if (mesh_)
+		pipelines[3] = pipelines_->compile(meshPipeline(), shaders);
+	return pipelines;
 }
 
 }
@@ -7,14 +7,32 @@
 
 #include <array>
 #include <bitset>
+#include <chrono>
+#include <future>
+#include <memory>
 #include <vector>
 
 #include <vulkan/vulkan.hpp>
 #include <SDL.h>
 #include <vk_mem_alloc.h>
 
-#include "ImgSyncer.hpp"
-#include "TextureModule.hpp"
+#include "BindlessTable.hpp"
+#include "EngineConfig.hpp"
+#include "FrameArena.hpp"
+#include "FramePacer.hpp"
+#include "FrameTimings.hpp"
+#include "GeometryStore.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuScene.hpp"
+#include "PipelineCache.hpp"
+#include "PipelineCompiler.hpp"
+#include "ShaderPack.hpp"
+#include "ShaderWatcher.hpp"
+#include "SpriteBatch.hpp"
+#include "StagingRing.hpp"
+#include "FrameContext.hpp"
+#include "TextureStreamer.hpp"
+#include "ThreadPool.hpp"
 
 namespace VulkanPlayground
 {
@@ -24,7 +42,7 @@ namespace VulkanPlayground
 	class BaseEngine
 	{
 	public:
-		BaseEngine();
+		explicit BaseEngine(const EngineConfig& config = {});
 		~BaseEngine();
 
 		BaseEngine(const BaseEngine&) = delete;
@@ -33,12 +51,91 @@ namespace VulkanPlayground
 		BaseEngine& operator=(BaseEngine&&) = delete;
 
 		void run();
+		// Render one frame outside of run(), returns whether the presenter had to be rebuilt
+		bool renderFrame();
+		const FrameTimings& frameTimings() const;
+		const GpuProfiler& gpuProfiler() const { return *profiler_; }
+		const FramePacer& framePacer() const { return pacer_; }
+		// Meshes can be streamed in and out between frames
+		GeometryStore& geometry() { return *geometry_; }
+		// Loads return immediately, the texture shows up once uploaded
+		TextureStreamer& textures() { return *textures_; }
+		// The texture on the quad
+		TextureHandle mainTexture() const { return mainTexture_; }
+		// A unit quad around the origin in the x = 1 plane, sprites and scene objects are drawn with it
+		const MeshHandle& quadMesh() const { return quadMesh_; }
+		// Filled anew every frame, drawn over the quad by the next renderFrame()
+		SpriteBatch& sprites() { return sprites_; }
+		// Objects culled on the GPU, null when disabled or unsupported
+		GpuScene* scene() { return scene_.get(); }
+		ThreadPool& threadPool() { return *threadPool_; }
+		const ShaderPack& shaders() const { return *shaders_; }
+		// Null when disabled in the config
+		const TextureCache* textureCache() const { return textureCache_.get(); }
+		const vk::PhysicalDevice& physicalDevice() const { return chosenGPU_; }
 
 		void ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&);
 		void initPresenter();
 
 	private:
-		SDL_Window * window_;
+		// The textured quad
+		PipelineDesc quadPipeline() const
+		{
+			return {
+				.fragment = bindless_ ? "bindless.frag" : "trig.frag",
+				.layout = globalPipelineLayout_,
+				.renderPass = renderPass_
+			};
+		}
+		// Instances of the quad mesh, blended
+		PipelineDesc spritePipeline() const
+		{
+			auto desc = quadPipeline();
+			desc.vertex = "sprite.vert";
+			desc.blend = true;
+			desc.instances = InstanceInput::Sprite;
+			return desc;
+		}
+		// Instances written by the culling pass, with a texture each
+		PipelineDesc scenePipeline() const
+		{
+			auto desc = quadPipeline();
+			desc.vertex = "scene.vert";
+			if (nonUniformTextures_)
+				desc.fragment = "scene.frag";
+			desc.instances = InstanceInput::Scene;
+			return desc;
+		}
+		// The imported mesh, scaled to its bounds and turned to face the camera
+		PipelineDesc meshPipeline() const
+		{
+			auto desc = quadPipeline();
+			desc.vertex = "mesh.vert";
+			desc.vertices = VertexStream::Mesh;
+			return desc;
+		}
+		// The quad, sprite, scene and mesh pipelines, the last two only with a scene or mesh
+		using Pipelines = std::array<std::shared_future<vk::Pipeline>, 4>;
+		Pipelines compilePipelines(const ShaderPack& shaders) const;
+		// Called between frames, never waits for the compile
+		void reloadShaders();
+
+		EngineConfig config_;
+		FramePacer pacer_;
+		std::unique_ptr<ThreadPool> threadPool_;
+		std::unique_ptr<ShaderPack> shaders_;
+		// Only with shaderHotReload
+		std::unique_ptr<ShaderWatcher> shaderWatcher_;
+		// Mapped pack and pipeline of the reload in progress
+		std::unique_ptr<ShaderPack> reloadedShaders_;
+		Pipelines shaderReload_;
+		std::chrono::steady_clock::time_point reloadStart_;
+		// Changed again while a reload was compiling
+		bool shadersChanged_ = false;
+
+		// Only used in headless mode, otherwise SDL owns the vulkan loader
+		std::unique_ptr<vk::DynamicLoader> loader_;
+		SDL_Window * window_ = nullptr;
 		vk::Instance instance_;
 		vk::DebugUtilsMessengerEXT debugMsg_;
 		vk::SurfaceKHR surface_;
@@ -52,19 +149,34 @@ namespace VulkanPlayground
 		vk::RenderPass renderPass_;
 
 		uint32_t imageCount_;
-		std::vector<ImgSyncer> syncObjs_;
+		std::vector<FrameContext> frames_;
 
 		VmaAllocator vma_;
-
-		std::vector<TextureModule> texture_;
+		std::unique_ptr<GpuProfiler> profiler_;
+		std::unique_ptr<PipelineCache> pipelineCache_;
+		std::unique_ptr<PipelineCompiler> pipelines_;
+		std::unique_ptr<StagingRing> staging_;
+		// Per frame uniforms, bound through globalDescriptor with a dynamic offset
+		std::unique_ptr<FrameArena> frameArena_;
+		std::unique_ptr<GeometryStore> geometry_;
+		MeshHandle quadMesh_;
+		SpriteBatch sprites_;
+		std::unique_ptr<GpuScene> scene_;
+		// Loaded from config_.meshPath, empty without one
+		MeshHandle mesh_;
+		glm::vec4 meshBounds_ {0.0f};
+
+		// Null without descriptor indexing
+		std::unique_ptr<BindlessTable> bindless_;
+		// Textures can be indexed by values that differ within a draw call
+		bool nonUniformTextures_ = false;
+		std::unique_ptr<TextureCache> textureCache_;
+		std::unique_ptr<TextureStreamer> textures_;
+		TextureHandle mainTexture_;
 		vk::Sampler sampler_;
 
-		vk::Buffer view_;
-		VmaAllocation viewAlloc_;
-
 		vk::DescriptorPool descriptorPool_;
 		vk::DescriptorSetLayout globalDescriptorLayout_;
-		std::vector<vk::DescriptorSet> globalDescriptors_;
 
 		vk::PipelineLayout globalPipelineLayout_;
 
@@ -0,0 +1,98 @@
+//
+// Created by ocean on 4/3/22.
+//
+
+#include "BindlessTable.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+bool BindlessTable::supported(const vk::PhysicalDeviceVulkan12Features& features)
+{
+	// The index is a push constant, uniform across the draw, so non-uniform indexing is not needed
+	return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound
+		&& features.descriptorBindingSampledImageUpdateAfterBind;
+}
+
+uint32_t BindlessTable::maxCapacity(vk::PhysicalDevice gpu)
+{
+	const auto props = gpu.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+	const auto& limits = props.get<vk::PhysicalDeviceVulkan12Properties>();
+	// A combined image sampler counts as both a sampler and a sampled image
+	return std::min({
+		limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+		limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		limits.maxDescriptorSetUpdateAfterBindSamplers,
+		limits.maxDescriptorSetUpdateAfterBindSampledImages,
+		limits.maxPerStageUpdateAfterBindResources
+	});
+}
+
+BindlessTable::BindlessTable(vk::Device device, vk::Sampler sampler, uint32_t capacity, uint32_t frames)
+	: device_(device), sampler_(sampler), capacity_(capacity), applied_(frames, 0)
+{
+	const vk::DescriptorSetLayoutBinding binding {
+		0, vk::DescriptorType::eCombinedImageSampler, capacity_, vk::ShaderStageFlagBits::eFragment, nullptr
+	};
+	const vk::DescriptorBindingFlags flags = vk::DescriptorBindingFlagBits::eUpdateAfterBind
+		| vk::DescriptorBindingFlagBits::ePartiallyBound;
+	const vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlags {flags};
+	layout_ = device_.createDescriptorSetLayout({
+		vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, binding, &bindingFlags
+	});
+
+	const vk::DescriptorPoolSize size {vk::DescriptorType::eCombinedImageSampler, capacity_ * frames};
+	pool_ = device_.createDescriptorPool({vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, frames, size});
+	const std::vector<vk::DescriptorSetLayout> layouts(frames, layout_);
+	sets_ = device_.allocateDescriptorSets({pool_, layouts});
+	spdlog::info("Bindless texture table of {} slots", capacity_);
+}
+
+BindlessTable::~BindlessTable()
+{
+	device_.destroy(pool_);
+	device_.destroy(layout_);
+}
+
+void BindlessTable::set(uint32_t slot, vk::ImageView view)
+{
+	if (slot >= capacity_) {
+		spdlog::warn("Texture {} is past the {} slots of the bindless table", slot, capacity_);
+		return;
+	}
+	writes_.emplace_back(slot, view);
+}
+
+vk::DescriptorSet BindlessTable::beginFrame(uint32_t frame)
+{
+	const auto set = sets_[frame];
+	auto& applied = applied_[frame];
+	if (applied == writes_.size())
+		return set;
+
+	const auto count = writes_.size() - applied;
+	std::vector<vk::DescriptorImageInfo> images(count);
+	std::vector<vk::WriteDescriptorSet> updates(count);
+	for (size_t i = 0; i < count; i++) {
+		const auto& [slot, view] = writes_[applied + i];
+		images[i] = {sampler_, view, vk::ImageLayout::eShaderReadOnlyOptimal};
+		updates[i] = {set, 0, slot, 1, vk::DescriptorType::eCombinedImageSampler, &images[i]};
+	}
+	device_.updateDescriptorSets(updates, {});
+	applied = writes_.size();
+
+	// Forget what every set has seen
+	const auto seen = *std::min_element(applied_.begin(), applied_.end());
+	if (seen) {
+		writes_.erase(writes_.begin(), writes_.begin() + static_cast<ptrdiff_t>(seen));
+		for (auto& a : applied_)
+			a -= seen;
+	}
+	return set;
+}
+
+}
@@ -0,0 +1,64 @@
+//
+// Created by ocean on 4/3/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_BINDLESSTABLE_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_BINDLESSTABLE_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground
+{
+
+/// One large array of combined image samplers every texture has a slot in,
+/// so draws pick their texture by index, pushed as a constant, instead of
+/// binding a descriptor set each.
+/// The binding is partially bound, only slots that were set may be
+/// sampled, and update-after-bind, which lifts its size far beyond the
+/// per-stage sampler limits of ordinary bindings.
+///
+/// Every frame in flight has its own set. Writes are logged and applied to a
+/// frame's set in beginFrame, once the frame that last used it has retired.
+class BindlessTable
+{
+public:
+	/// Whether the device has the descriptor indexing features this needs
+	static bool supported(const vk::PhysicalDeviceVulkan12Features& features);
+	/// The most slots the device allows
+	static uint32_t maxCapacity(vk::PhysicalDevice gpu);
+
+	BindlessTable(vk::Device device, vk::Sampler sampler, uint32_t capacity, uint32_t frames);
+	~BindlessTable();
+
+	BindlessTable(const BindlessTable&) = delete;
+	BindlessTable& operator=(const BindlessTable&) = delete;
+
+	/// Set 1 of pipelines drawing with the table
+	vk::DescriptorSetLayout layout() const { return layout_; }
+	uint32_t capacity() const { return capacity_; }
+
+	/// Point slot at view from the next frame on, logs and ignores slots past the capacity
+	void set(uint32_t slot, vk::ImageView view);
+	/// The set to bind for frame, brought up to date. Call once its fence has signaled.
+	vk::DescriptorSet beginFrame(uint32_t frame);
+
+private:
+	vk::Device device_;
+	vk::Sampler sampler_;
+	uint32_t capacity_;
+	vk::DescriptorSetLayout layout_;
+	vk::DescriptorPool pool_;
+	std::vector<vk::DescriptorSet> sets_;
+
+	// Writes not yet applied to every set, and how far each set got
+	std::vector<std::pair<uint32_t, vk::ImageView>> writes_;
+	std::vector<size_t> applied_;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_BINDLESSTABLE_HPP
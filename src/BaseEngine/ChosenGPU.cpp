@@ -4,7 +4,9 @@
 
 #include "BaseEngine.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <stdexcept>
 
 #include <spdlog/spdlog.h>
@@ -14,6 +16,19 @@
 namespace VulkanPlayground
 {
 
+constexpr static std::array<Vertex, 4> defaultVertices {
+	{
+		{packHalf2({-0.5f, -0.5f}), packHalf2({2.0f, 2.0f})},
+		{packHalf2({-0.5f,  0.5f}), packHalf2({2.0f, 0.0f})},
+		{packHalf2({ 0.5f, -0.5f}), packHalf2({0.0f, 2.0f})},
+		{packHalf2({ 0.5f,  0.5f}), packHalf2({0.0f, 0.0f})},
+	}
+};
+
+constexpr static std::array<uint32_t, 6> defaultIndexes {
+	0, 1, 2, 2, 1, 3
+};
+
 void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>& pref) {
 	auto availGPUs = instance_.enumeratePhysicalDevices();
 	if (availGPUs.empty()) {
@@ -26,6 +41,7 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 		int score = pref(availGPUs[i]);
 		if (bestScore < score) {
 			best = i;
+			bestScore = score;
 		}
 	}
 
@@ -41,9 +57,10 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 		const auto& family = queueFamilies[i];
 		spdlog::info("\t{}\t{}", family.queueCount, to_string(family.queueFlags));
 
-		if (family.queueFlags & vk::QueueFlagBits::eGraphics)
-			if (bestGPU.getSurfaceSupportKHR(i, surface_))
-				graphicsQF_ = i;
+		if (graphicsQF_ != badQF || !(family.queueFlags & vk::QueueFlagBits::eGraphics))
+			continue;
+		if (config_.headless || bestGPU.getSurfaceSupportKHR(i, surface_))
+			graphicsQF_ = i;
 	}
 
 	if (graphicsQF_ == badQF) {
@@ -57,20 +74,74 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 	std::array<vk::DeviceQueueCreateInfo, 1> queues {
 		vk::DeviceQueueCreateInfo {{}, graphicsQF_, 1, &priority}
 	};
-	// TODO: Make GPU debug optional
-	std::array<const char*, 1> explicitLayers { "VK_LAYER_KHRONOS_validation" };
+	std::vector<const char*> explicitLayers;
+	if (config_.validation)
+		explicitLayers.push_back("VK_LAYER_KHRONOS_validation");
 	// TODO: Make enabled device extension configurable
-	std::array<const char*, 1> deviceExtensions { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-
-	device_ = bestGPU.createDevice({
-		{},
-		queues,
-		explicitLayers,
-		deviceExtensions
-	});
+	std::vector<const char*> deviceExtensions;
+	if (!config_.headless)
+		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+	const auto availExtensions = bestGPU.enumerateDeviceExtensionProperties();
+	const auto hasExtension = [&](const char* name) {
+		return std::any_of(availExtensions.begin(), availExtensions.end(), [&](const auto& ext) {
+			return std::strcmp(ext.extensionName, name) == 0;
+		});
+	};
+	// Only used to tell pipeline cache hits from misses
+	const bool creationFeedback = hasExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+	if (creationFeedback)
+		deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+	// Descriptor indexing and indirect counts are core in 1.2, the features can only be chained from there on
+	bool bindless = false;
+	bool drawCount = false;
+	if (GPUProp.apiVersion >= VK_API_VERSION_1_2) {
+		const auto features = bestGPU.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+		const auto& features12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+		bindless = config_.bindlessTextures && BindlessTable::supported(features12);
+		drawCount = features12.drawIndirectCount;
+		// Objects of the GPU scene pick their texture per draw of one indirect call
+		nonUniformTextures_ = bindless && features12.shaderSampledImageArrayNonUniformIndexing;
+	}
+	if (config_.bindlessTextures && !bindless)
+		spdlog::info("No descriptor indexing, binding textures per draw");
+
+	const bool scene = config_.sceneObjects && GpuScene::supported(bestGPU.getFeatures());
+	if (config_.sceneObjects && !scene)
+		spdlog::info("No multi draw indirect, the GPU scene is disabled");
+	drawCount = drawCount && scene;
+
+	vk::PhysicalDeviceFeatures enabledFeatures;
+	enabledFeatures.setMultiDrawIndirect(scene)
+		.setDrawIndirectFirstInstance(scene);
+	vk::StructureChain device {
+		vk::DeviceCreateInfo {
+			{},
+			queues,
+			explicitLayers,
+			deviceExtensions,
+			&enabledFeatures
+		},
+		vk::PhysicalDeviceVulkan12Features {}
+			.setRuntimeDescriptorArray(bindless)
+			.setDescriptorBindingPartiallyBound(bindless)
+			.setDescriptorBindingSampledImageUpdateAfterBind(bindless)
+			.setShaderSampledImageArrayNonUniformIndexing(nonUniformTextures_)
+			.setDrawIndirectCount(drawCount)
+	};
+	if (!bindless && !drawCount)
+		device.unlink<vk::PhysicalDeviceVulkan12Features>();
+	device_ = bestGPU.createDevice(device.get());
 	graphicsQ_ = device_.getQueue(graphicsQF_, 0);
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(device_);
 
+	pipelineCache_ = std::make_unique<PipelineCache>(device_, chosenGPU_, config_.pipelineCachePath, creationFeedback);
+	pipelines_ = std::make_unique<PipelineCompiler>(device_, *pipelineCache_, *threadPool_);
+
+	const auto framesInFlight = std::max(1u, config_.framesInFlight);
+	profiler_ = std::make_unique<GpuProfiler>(device_, chosenGPU_, graphicsQF_, framesInFlight);
+
 	graphicsCmdPool_ = device_.createCommandPool({
 		vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
 		graphicsQF_
@@ -101,29 +172,52 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 	}
 
 	// Determine Image Count
-	{
+	if (config_.headless) {
+		// One offscreen target per frame in flight, nothing else holds on to them
+		imageCount_ = framesInFlight;
+	} else {
 		const auto surfaceCap = chosenGPU_.getSurfaceCapabilitiesKHR(surface_);
 
-		if (surfaceCap.maxImageCount < 2) {
+		// maxImageCount of 0 means there is no upper limit
+		if (surfaceCap.maxImageCount != 0 && surfaceCap.maxImageCount < 2) {
 			spdlog::error("The device does not support for more than two images!");
 			std::terminate();
 		}
 
-		imageCount_ = std::max(2u, surfaceCap.minImageCount);
+		imageCount_ = std::max({2u, surfaceCap.minImageCount, config_.swapchainImages});
+		if (surfaceCap.maxImageCount != 0)
+			imageCount_ = std::min(imageCount_, surfaceCap.maxImageCount);
 	}
+	spdlog::info("{} frames in flight over {} images", framesInFlight, imageCount_);
 
-	for (unsigned i = 0; i < imageCount_; i++) {
-		syncObjs_.push_back(
+	for (unsigned i = 0; i < framesInFlight; i++) {
+		const auto pool = device_.createCommandPool({
+			vk::CommandPoolCreateFlagBits::eTransient,
+			graphicsQF_
+		});
+		const auto cmdBuffers = device_.allocateCommandBuffers({
+			pool,
+			vk::CommandBufferLevel::ePrimary,
+			1
+		});
+		frames_.push_back(
 			{
-				.renderComplete = device_.createSemaphore({}),
+				.cmdPool = pool,
+				.cmdBuffer = cmdBuffers.front(),
 				.imageAvailable = device_.createSemaphore({}),
-				.imageDone = device_.createFence({vk::FenceCreateFlagBits::eSignaled})
+				.frameDone = device_.createFence({vk::FenceCreateFlagBits::eSignaled})
 		});
 	}
 
 	// Determine Surface Format
 	surfaceFmt_ = { vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear };
-	{
+	if (config_.headless) {
+		const auto formatProp = chosenGPU_.getFormatProperties(surfaceFmt_.format);
+		if (!(formatProp.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment)) {
+			spdlog::error("The GPU cannot render to {}", to_string(surfaceFmt_.format));
+			std::terminate();
+		}
+	} else {
 		using enum vk::Format;
 		using enum vk::ColorSpaceKHR;
 		const auto formatSups = chosenGPU_.getSurfaceFormatsKHR(surface_);
@@ -140,6 +234,11 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 
 	// Create Renderpass
 	{
+		// Offscreen images are left ready to be copied out instead of presented
+		const auto finalLayout = config_.headless
+			? vk::ImageLayout::eTransferSrcOptimal
+			: vk::ImageLayout::ePresentSrcKHR;
+
 		std::array<vk::AttachmentDescription,1> attachment {
 			{
 				{
@@ -151,7 +250,7 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 					vk::AttachmentLoadOp::eDontCare,
 					vk::AttachmentStoreOp::eDontCare,
 					vk::ImageLayout::eUndefined,
-					vk::ImageLayout::ePresentSrcKHR}
+					finalLayout}
 			}};
 
 		std::array<vk::AttachmentReference, 1> colorAttachRef = {
@@ -188,46 +287,50 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 			});
 	}
 
+	staging_ = std::make_unique<StagingRing>(vma_, device_, graphicsQ_, graphicsQF_, config_.stagingSize);
+	geometry_ = std::make_unique<GeometryStore>(vma_, *staging_);
+	frameArena_ = std::make_unique<FrameArena>(vma_, chosenGPU_, framesInFlight, config_.frameArenaSize);
+	if (scene) {
+		scene_ = std::make_unique<GpuScene>(device_, chosenGPU_, vma_, *pipelineCache_, *shaders_,
+			framesInFlight, config_.sceneObjects, drawCount);
+	}
+	quadMesh_ = geometry_->add(defaultVertices, defaultIndexes);
+	if (!config_.meshPath.empty()) {
+		// The staged copy is all the GPU needs, the mapping goes right after
+		if (const auto file = MeshFile::open(config_.meshPath.c_str())) {
+			mesh_ = geometry_->add(*file);
+			meshBounds_ = file->bounds();
+		}
+		if (!mesh_)
+			spdlog::warn("Drawing without the mesh {}", config_.meshPath);
+	}
+
 	{
-		texture_.push_back(TextureModule::uploadTexture("../assets/textures/IMG_0800.JPG", vma_, device_, graphicsQ_, graphicsCmdPool_));
+		// Trilinear
 		vk::SamplerCreateInfo samplerInfo;
-		samplerInfo.setMagFilter(vk::Filter::eLinear);
+		samplerInfo.setMagFilter(vk::Filter::eLinear)
+			.setMinFilter(vk::Filter::eLinear)
+			.setMipmapMode(vk::SamplerMipmapMode::eLinear)
+			.setMaxLod(VK_LOD_CLAMP_NONE);
 		sampler_ = device_.createSampler(samplerInfo);
 
-		VkBuffer uniform;
-		const auto uniformCreate = VkBufferCreateInfo {
-			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-			.size = sizeof(glm::mat4),
-			.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
-		};
-		const auto uniformAllocCreate = VmaAllocationCreateInfo {
-			.usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
-			.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-		};
-		auto result = vmaCreateBuffer(
-			vma_,
-			&uniformCreate,
-			&uniformAllocCreate,
-			&uniform,
-			&viewAlloc_,
-			nullptr
-			);
-		if (result != VK_SUCCESS) {
-			spdlog::error("Falied to allocate buffer");
-			std::terminate();
+		if (bindless) {
+			const auto capacity = std::min(config_.bindlessTextures, BindlessTable::maxCapacity(chosenGPU_));
+			bindless_ = std::make_unique<BindlessTable>(device_, sampler_, capacity, framesInFlight);
 		}
-
-		view_ = uniform;
+		if (!config_.textureCachePath.empty())
+			textureCache_ = std::make_unique<TextureCache>(config_.textureCachePath, config_.textureCacheSize);
+		textures_ = std::make_unique<TextureStreamer>(vma_, chosenGPU_, device_, *staging_,
+			*threadPool_, textureCache_.get(), bindless_.get(), config_.mipmaps, config_.textureDecodeBudget);
+		mainTexture_ = textures_->load("../assets/textures/IMG_0800.JPG");
 	}
 
 	{
 		std::array sizes {
-			vk::DescriptorPoolSize { vk::DescriptorType::eUniformBuffer, 10u },
-			vk::DescriptorPoolSize { vk::DescriptorType::eCombinedImageSampler, 10u }
+			vk::DescriptorPoolSize { vk::DescriptorType::eUniformBufferDynamic, 10u + framesInFlight },
+			vk::DescriptorPoolSize { vk::DescriptorType::eCombinedImageSampler, 10u + framesInFlight }
 		};
-		descriptorPool_ = device_.createDescriptorPool({ vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 4, sizes });
+		descriptorPool_ = device_.createDescriptorPool({ vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 4 + framesInFlight, sizes });
 
 		std::array bindings {
 			vk::DescriptorSetLayoutBinding {
@@ -239,7 +342,7 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 			},
 			vk::DescriptorSetLayoutBinding {
 				1,
-				vk::DescriptorType::eUniformBuffer,
+				vk::DescriptorType::eUniformBufferDynamic,
 				1,
 				vk::ShaderStageFlagBits::eVertex,
 				nullptr
@@ -252,62 +355,70 @@ void BaseEngine::ChooseGPU(const std::function<int(const vk::PhysicalDevice&)>&
 	{
 		std::array pushConstants {
 			vk::PushConstantRange {
-					vk::ShaderStageFlagBits::eVertex,
+					vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
 					0,
-					sizeof(float) * 2
+					sizeof(MeshConstants)
 			}
 		};
+		// The bindless table is set 1
+		std::vector setLayouts {globalDescriptorLayout_};
+		if (bindless_)
+			setLayouts.push_back(bindless_->layout());
 		globalPipelineLayout_ = device_.createPipelineLayout(
 			{
-				{}, globalDescriptorLayout_, pushConstants
+				{}, setLayouts, pushConstants
 			});
 	}
 
 	// Allocator Descriptor Sets
 	{
-		std::vector<vk::DescriptorSetLayout> layouts(imageCount_, globalDescriptorLayout_);
-		globalDescriptors_ = device_.allocateDescriptorSets({descriptorPool_, layouts});
+		std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, globalDescriptorLayout_);
+		const auto sets = device_.allocateDescriptorSets({descriptorPool_, layouts});
+		for (unsigned i = 0; i < framesInFlight; i++)
+			frames_[i].globalDescriptor = sets[i];
 
 		std::array<vk::DescriptorImageInfo, 1> images {
 			{
 				{
-					sampler_, texture_.front().textureView, vk::ImageLayout::eShaderReadOnlyOptimal
-				}
-			}
-		};
-		std::array<vk::DescriptorBufferInfo, 1> uniforms {
-			{
-				{
-					view_, 0, sizeof(glm::mat4)
+					sampler_, textures_->placeholder(), vk::ImageLayout::eShaderReadOnlyOptimal
 				}
 			}
 		};
-		std::array<vk::WriteDescriptorSet, 2> updates;
-		for (unsigned i = 0 ; i < imageCount_; i++) {
+		// Each frame points at its slice of the arena, the dynamic offset picks the uniform
+		std::vector<vk::DescriptorBufferInfo> uniforms(framesInFlight);
+		for (unsigned i = 0; i < framesInFlight; i++)
+			uniforms[i] = { frameArena_->buffer(i), 0, sizeof(glm::mat4) };
+		std::vector<vk::WriteDescriptorSet> updates(framesInFlight);
+		for (unsigned i = 0 ; i < framesInFlight; i++) {
 			auto& write = updates[i];
-			write.setDstSet(globalDescriptors_[i])
+			write.setDstSet(sets[i])
 				.setDstBinding(0).setDstArrayElement(0)
 				.setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
 				.setDescriptorCount(1)
 				.setPImageInfo(&images[0]);
 		}
 		device_.updateDescriptorSets(updates, {});
-		for (unsigned i = 0 ; i < imageCount_; i++) {
+		for (unsigned i = 0 ; i < framesInFlight; i++) {
 			auto& write = updates[i];
-			write.setDstSet(globalDescriptors_[i])
+			write.setDstSet(sets[i])
 				.setDstBinding(1).setDstArrayElement(0)
-				.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+				.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 				.setDescriptorCount(1)
-				.setPBufferInfo(&uniforms[0]);
+				.setPBufferInfo(&uniforms[i]);
 		}
 		device_.updateDescriptorSets(updates, {});
 	}
 
 	initPresenter();
+	pipelines_->report();
+	pipelineCache_->report();
 }
 
 void BaseEngine::initPresenter() {
-	presenter_ = std::make_unique<Presenter>(*this, presenter_.get());
+	if (presenter_)
+		presenter_->resize();
+	else
+		presenter_ = std::make_unique<Presenter>(*this);
 }
 
 }
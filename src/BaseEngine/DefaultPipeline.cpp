@@ -2,7 +2,15 @@
 // Created by ocean on 1/22/22.
 //
 
-#include <vulkan/vulkan.hpp>
+#include "DefaultPipeline.hpp"
+
+#include <array>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "MeshFile.hpp"
+#include "Vertex.hpp"
 
 namespace VulkanPlayground
 {
@@ -32,4 +40,134 @@ constexpr vk::SubpassDescription dfltSubpass = {
 	1, &dfltColorAttachRef
 };
 
-}
\ No newline at end of file
+vk::ResultValue<vk::Pipeline> createGraphicsPipeline(
+	vk::Device device,
+	PipelineCache& cache,
+	const ShaderPack& shaders,
+	const PipelineDesc& desc)
+{
+	// Created straight from the mapped pack
+	const auto vertCode = shaders.find(desc.vertex);
+	const auto fragCode = shaders.find(desc.fragment);
+	if (vertCode.empty() || fragCode.empty()) {
+		spdlog::error("The shader pack lacks {} or {}", desc.vertex, desc.fragment);
+		return {vk::Result::eErrorInitializationFailed, {}};
+	}
+	auto vert = device.createShaderModuleUnique(
+		{ {}, vertCode.size_bytes(), vertCode.data() });
+	auto frag = device.createShaderModuleUnique(
+		{ {}, fragCode.size_bytes(), fragCode.data() });
+
+	vk::PipelineShaderStageCreateInfo shaderStage[] = {
+		{
+			{},
+			vk::ShaderStageFlagBits::eVertex,
+			*vert,
+			"main"
+		},
+		{
+			{},
+			vk::ShaderStageFlagBits::eFragment,
+			*frag,
+			"main"
+		}
+	};
+
+	std::vector<vk::VertexInputBindingDescription> bindings;
+	std::vector<vk::VertexInputAttributeDescription> attributes;
+	const auto input = [&](const auto& layout) {
+		bindings.push_back(layout.binding);
+		attributes.insert(attributes.end(), layout.attributes.begin(), layout.attributes.end());
+	};
+	switch (desc.vertices) {
+	case VertexStream::Quad:
+		input(VertexInput<Vertex>::layout);
+		break;
+	case VertexStream::Mesh:
+		input(VertexInput<MeshVertex>::layout);
+		break;
+	}
+	switch (desc.instances) {
+	case InstanceInput::None:
+		break;
+	case InstanceInput::Sprite:
+		input(VertexInput<SpriteInstance>::layout);
+		break;
+	case InstanceInput::Scene:
+		input(VertexInput<SceneInstance>::layout);
+		break;
+	}
+	vk::PipelineVertexInputStateCreateInfo vertexInput = {
+		{}, bindings, attributes
+	};
+
+	vk::PipelineInputAssemblyStateCreateInfo inputAssembly = {
+		{}, vk::PrimitiveTopology::eTriangleList, VK_FALSE
+	};
+
+	// Set at record time from the framebuffer extent
+	vk::PipelineViewportStateCreateInfo viewportState = {
+		{}, 1, nullptr, 1, nullptr
+	};
+
+	std::array dynamicStates {
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor
+	};
+	vk::PipelineDynamicStateCreateInfo dynamicState = {
+		{}, dynamicStates
+	};
+
+	vk::PipelineRasterizationStateCreateInfo rasterization;
+	rasterization.setCullMode(desc.cullMode);
+	rasterization.setFrontFace(vk::FrontFace::eCounterClockwise);
+	rasterization.setLineWidth(1.0f);
+
+	vk::PipelineMultisampleStateCreateInfo multisample;
+	multisample.setRasterizationSamples(vk::SampleCountFlagBits::e1)
+		.setSampleShadingEnable(VK_FALSE);
+
+	vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+	colorBlendAttachment.setBlendEnable(desc.blend)
+	.setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+	.setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+	.setColorBlendOp(vk::BlendOp::eAdd)
+	.setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+	.setDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+	.setAlphaBlendOp(vk::BlendOp::eAdd)
+	.setColorWriteMask(
+		vk::ColorComponentFlagBits::eR |
+		vk::ColorComponentFlagBits::eG |
+		vk::ColorComponentFlagBits::eB |
+		vk::ColorComponentFlagBits::eA
+		);
+
+	vk::PipelineColorBlendStateCreateInfo colorBlend = {
+		{},
+		VK_FALSE, vk::LogicOp::eCopy,
+		colorBlendAttachment,
+		{1.0f, 1.0f, 1.0f, 1.0f}
+	};
+
+	return cache.createGraphicsPipeline(
+		{
+			{},
+			2, shaderStage,
+			&vertexInput,
+			&inputAssembly,
+			nullptr,
+			&viewportState,
+			&rasterization,
+			&multisample,
+			nullptr,
+			&colorBlend,
+			&dynamicState,
+			desc.layout,
+			desc.renderPass,
+			0,
+			VK_NULL_HANDLE,
+			0
+	});
+}
+
+}
@@ -0,0 +1,77 @@
+//
+// Created by ocean on 3/11/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_DEFAULTPIPELINE_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_DEFAULTPIPELINE_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <vulkan/vulkan.hpp>
+
+#include "PipelineCache.hpp"
+#include "ShaderPack.hpp"
+#include "Vertex.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Per instance attributes at binding 1, after the vertex ones
+enum class InstanceInput
+{
+	None,
+	Sprite,
+	Scene,
+};
+
+/// What differs between graphics pipelines, everything else is the fixed
+/// state of the textured quad pipeline.
+/// Viewport and scissor are dynamic state, so pipelines survive resizes.
+struct PipelineDesc
+{
+	// Module names in the shader pack
+	std::string vertex = "trig.vert";
+	std::string fragment = "trig.frag";
+	vk::PipelineLayout layout;
+	vk::RenderPass renderPass;
+	vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+	// Straight alpha blending instead of overwriting
+	bool blend = false;
+	InstanceInput instances = InstanceInput::None;
+	// Vertex type at binding 0, the GeometryStore binds the matching buffer
+	VertexStream vertices = VertexStream::Quad;
+
+	bool operator==(const PipelineDesc&) const = default;
+};
+
+/// Push constants of the quad pipelines
+struct QuadConstants
+{
+	float viewCenter[2];
+	// Slot in the bindless table, ignored without it
+	uint32_t texture;
+};
+
+/// Push constants of the mesh pipeline, the quad ones come first so the
+/// fragment shaders read them unchanged
+struct MeshConstants
+{
+	QuadConstants quad;
+	float padding;
+	// MeshFile::bounds, the mesh is scaled to fit a unit sphere
+	float bounds[4];
+};
+// A vec4 is 16 byte aligned in the push constant block
+static_assert(offsetof(MeshConstants, bounds) == 16);
+
+/// Thread-safe, called by the PipelineCompiler workers
+vk::ResultValue<vk::Pipeline> createGraphicsPipeline(
+	vk::Device device,
+	PipelineCache& cache,
+	const ShaderPack& shaders,
+	const PipelineDesc& desc);
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_DEFAULTPIPELINE_HPP
@@ -0,0 +1,78 @@
+//
+// Created by ocean on 3/2/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_ENGINECONFIG_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_ENGINECONFIG_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace VulkanPlayground
+{
+
+enum class PacingPolicy
+{
+	// Let FIFO presentation block on the display refresh
+	VSync,
+	// Sleep on the CPU to targetFps, presenting without vsync
+	Fixed,
+	// As fast as the device goes
+	Uncapped,
+};
+
+struct EngineConfig
+{
+	// Render into a pool of offscreen images instead of a window surface.
+	// No SDL window is created and frames are not throttled.
+	bool headless = false;
+	// Enable VK_LAYER_KHRONOS_validation and the debug messenger
+	bool validation = true;
+	// Initial window size, or the render extent in headless mode
+	std::array<int, 2> extent = {640, 480};
+	// Frames the CPU may record ahead of the GPU, independent of the image count
+	uint32_t framesInFlight = 2;
+	// Swapchain images to request, 0 picks the surface minimum (at least two).
+	// Clamped to what the surface supports.
+	uint32_t swapchainImages = 0;
+	// Headless mode is always uncapped
+	PacingPolicy pacing = PacingPolicy::Fixed;
+	double targetFps = 60.0;
+	// Background threads for loading and compiling, 0 leaves one core to the render thread
+	unsigned workerThreads = 0;
+	// Slots of the bindless texture table, clamped to the device limits, 0
+	// disables it. Needs Vulkan 1.2 descriptor indexing, without it the one
+	// texture drawn is bound per frame.
+	uint32_t bindlessTextures = 4096;
+	// Objects the GPU culls and draws on its own, 0 disables it.
+	// Needs multiDrawIndirect and drawIndirectFirstInstance.
+	uint32_t sceneObjects = 65536;
+	// Generate full mip chains for loaded textures
+	bool mipmaps = true;
+	// Persistently mapped ring every upload is staged through
+	uint64_t stagingSize = 64ull << 20;
+	// Uniforms and dynamic geometry written per frame, for each frame in flight
+	uint64_t frameArenaSize = 4ull << 20;
+	// Upper bound on decoded texture pixels held in memory while loading
+	uint64_t textureDecodeBudget = 256ull << 20;
+	// Directory decoded textures are cached in across runs, empty disables it
+	std::string textureCachePath = "texture.cache";
+	// Least recently used entries are evicted beyond this
+	uint64_t textureCacheSize = 1ull << 30;
+	// A mesh written by the MeshImporter tool, drawn over the quad. Empty disables it.
+	std::string meshPath;
+	// Every SPIR-V module, built by the shaders target
+	std::string shaderPackPath = "assets/shaders.pack";
+	// Development mode: rebuild the pipelines in the background whenever the
+	// shader pack is rebuilt, swapping them in between frames
+	bool shaderHotReload = false;
+	// Where the pipeline cache is loaded from and saved to, empty keeps it in memory
+	std::string pipelineCachePath = "pipeline.cache";
+	// Stop BaseEngine::run after this many frames, 0 runs until SDL_QUIT
+	uint64_t maxFrames = 0;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_ENGINECONFIG_HPP
@@ -0,0 +1,121 @@
+//
+// Created by ocean on 4/4/22.
+//
+
+#include "FrameArena.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+// Covers the alignment any implementation asks of a buffer, so the slices
+// pack the block of the pool without gaps
+constexpr vk::DeviceSize sliceGranularity = 64ull << 10;
+
+vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+FrameArena::FrameArena(VmaAllocator allocator, vk::PhysicalDevice gpu, unsigned frames,
+	vk::DeviceSize bytesPerFrame)
+	: allocator_(allocator), slices_(frames),
+	  capacity_(alignUp(std::max<vk::DeviceSize>(bytesPerFrame, 1), sliceGranularity)),
+	  uniformAlignment_(gpu.getProperties().limits.minUniformBufferOffsetAlignment)
+{
+	const auto bufferCreate = VkBufferCreateInfo {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = capacity_,
+		.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+			| VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+	// Written once by the CPU and read once by the GPU, device local when the
+	// host can map it
+	VmaAllocationCreateInfo allocCreate = {
+		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+		.usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+		.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	};
+	uint32_t memoryType;
+	if (vmaFindMemoryTypeIndexForBufferInfo(allocator_, &bufferCreate, &allocCreate, &memoryType) != VK_SUCCESS) {
+		spdlog::error("No host visible memory for the frame arena");
+		std::terminate();
+	}
+
+	// One block holding every slice, allocated up front
+	const VmaPoolCreateInfo poolCreate = {
+		.memoryTypeIndex = memoryType,
+		.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+		.blockSize = capacity_ * frames,
+		.minBlockCount = 1,
+		.maxBlockCount = 1
+	};
+	if (vmaCreatePool(allocator_, &poolCreate, &pool_) != VK_SUCCESS) {
+		spdlog::error("Failed to create the frame arena pool");
+		std::terminate();
+	}
+
+	allocCreate.pool = pool_;
+	for (auto& slice : slices_) {
+		VkBuffer buffer;
+		VmaAllocationInfo allocInfo;
+		if (vmaCreateBuffer(allocator_, &bufferCreate, &allocCreate, &buffer, &slice.alloc, &allocInfo) != VK_SUCCESS) {
+			spdlog::error("Failed to allocate a frame arena slice");
+			std::terminate();
+		}
+		slice.buffer = buffer;
+		slice.data = static_cast<std::byte *>(allocInfo.pMappedData);
+	}
+
+	VkMemoryPropertyFlags memoryFlags;
+	vmaGetMemoryTypeProperties(allocator_, memoryType, &memoryFlags);
+	coherent_ = memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	spdlog::info("Frame arena: {} KiB per frame{}", capacity_ >> 10,
+		memoryFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ? " in device local memory" : "");
+}
+
+FrameArena::~FrameArena()
+{
+	for (const auto& slice : slices_)
+		vmaDestroyBuffer(allocator_, slice.buffer, slice.alloc);
+	vmaDestroyPool(allocator_, pool_);
+}
+
+void FrameArena::beginFrame(unsigned frame)
+{
+	frame_ = frame;
+	head_ = 0;
+	exhausted_ = false;
+}
+
+void FrameArena::flush()
+{
+	if (!coherent_ && head_ > 0)
+		vmaFlushAllocation(allocator_, slices_[frame_].alloc, 0, head_);
+}
+
+FrameArena::Allocation FrameArena::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	const auto begin = alignUp(head_, alignment);
+	if (begin + size > capacity_) {
+		if (!exhausted_)
+			spdlog::warn("Frame arena out of room, {} of {} bytes used", head_, capacity_);
+		exhausted_ = true;
+		return {};
+	}
+	head_ = begin + size;
+
+	const auto& slice = slices_[frame_];
+	return { slice.buffer, begin, slice.data + begin };
+}
+
+}
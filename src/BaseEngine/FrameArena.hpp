@@ -0,0 +1,109 @@
+//
+// Created by ocean on 4/4/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_FRAMEARENA_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_FRAMEARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.h>
+
+namespace VulkanPlayground
+{
+
+/// Transient GPU memory for data rewritten every frame: uniforms, dynamic
+/// vertices and indices, or the source of copies recorded into the frame.
+/// Every frame in flight owns a persistently mapped slice, all of them placed
+/// in one block of a VMA linear pool. Allocating bumps an offset into the slice
+/// of the current frame, which starts over in beginFrame() once the fence of
+/// the frame that last used it has signaled, so writing never races the GPU.
+/// Uniforms are meant to be bound as dynamic uniform buffers, with the offset
+/// of the allocation as the dynamic offset.
+///
+/// Render thread only.
+class FrameArena
+{
+public:
+	struct Allocation
+	{
+		vk::Buffer buffer;
+		// Into buffer, also the dynamic offset of a uniform
+		vk::DeviceSize offset = 0;
+		std::byte* data = nullptr;
+
+		explicit operator bool() const { return data != nullptr; }
+	};
+
+	/// bytesPerFrame is rounded up to 64 KiB
+	FrameArena(VmaAllocator allocator, vk::PhysicalDevice gpu, unsigned frames,
+		vk::DeviceSize bytesPerFrame = 4ull << 20);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	/// Hand out the slice of frame from its start.
+	/// Call after the fence of the frame has been waited on.
+	void beginFrame(unsigned frame);
+	/// Make what was written this frame visible to the device, before submitting
+	void flush();
+
+	/// Returns an empty allocation when the slice of the frame is full
+	Allocation allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+	/// Aligned for binding as a dynamic uniform buffer
+	Allocation uniform(vk::DeviceSize size) { return allocate(size, uniformAlignment_); }
+	template<typename T>
+	Allocation uniform(const T& value)
+	{
+		auto allocation = uniform(sizeof(T));
+		if (allocation)
+			std::memcpy(allocation.data, &value, sizeof(T));
+		return allocation;
+	}
+	/// Vertices or indices, copied in
+	template<typename T>
+	Allocation push(std::span<const T> data)
+	{
+		auto allocation = allocate(data.size_bytes(), alignof(T) < 4 ? 4 : alignof(T));
+		if (allocation)
+			std::memcpy(allocation.data, data.data(), data.size_bytes());
+		return allocation;
+	}
+
+	/// Buffer of the slice of frame, what descriptors of that frame point to
+	vk::Buffer buffer(unsigned frame) const { return slices_[frame].buffer; }
+	vk::DeviceSize capacity() const { return capacity_; }
+	vk::DeviceSize uniformAlignment() const { return uniformAlignment_; }
+	/// Bytes handed out so far this frame
+	vk::DeviceSize used() const { return head_; }
+
+private:
+	struct Slice
+	{
+		vk::Buffer buffer;
+		VmaAllocation alloc = nullptr;
+		std::byte* data = nullptr;
+	};
+
+	VmaAllocator allocator_;
+	VmaPool pool_ = nullptr;
+	std::vector<Slice> slices_;
+	vk::DeviceSize capacity_;
+	vk::DeviceSize uniformAlignment_;
+	bool coherent_ = true;
+
+	unsigned frame_ = 0;
+	vk::DeviceSize head_ = 0;
+	// Only warn once per frame about running out of room
+	bool exhausted_ = false;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_FRAMEARENA_HPP
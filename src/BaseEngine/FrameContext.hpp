@@ -0,0 +1,28 @@
+//
+// Created by ocean on 1/22/22.
+//
+
+#ifndef FRAMECONTEXT_HPP
+#define FRAMECONTEXT_HPP
+
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground {
+
+// Everything a frame in flight records into, reused once frameDone signals.
+// Render completion semaphores live with the swapchain images instead, as
+// the presentation engine may hold on to them past frameDone.
+struct FrameContext
+{
+	// Transient pool, reset as a whole at the start of the frame
+	vk::CommandPool cmdPool;
+	vk::CommandBuffer cmdBuffer;
+	vk::Semaphore imageAvailable;
+	vk::Fence frameDone;
+	vk::DescriptorSet globalDescriptor;
+};
+
+}
+
+
+#endif //FRAMECONTEXT_HPP
@@ -0,0 +1,158 @@
+//
+// Created by ocean on 3/16/22.
+//
+
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr auto reportInterval = 5s;
+constexpr auto minSlack = 50us;
+// Weight of a new oversleep sample in the running estimate
+constexpr double slackAlpha = 1.0 / 16.0;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+}
+
+FramePacer::FramePacer(PacingPolicy policy, double targetFps)
+	: policy_(policy)
+{
+	if (policy_ == PacingPolicy::Fixed && targetFps <= 0.0) {
+		spdlog::warn("Invalid target frame rate {}, running uncapped", targetFps);
+		policy_ = PacingPolicy::Uncapped;
+	}
+	period_ = policy_ == PacingPolicy::Fixed
+		? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / targetFps))
+		: clock::duration {};
+	if (policy_ == PacingPolicy::Fixed)
+		calibrate();
+
+	next_ = lastFrame_ = windowStart_ = clock::now();
+}
+
+void FramePacer::calibrate()
+{
+	// Seed the estimate so the first frames do not overshoot while it settles
+	for (int i = 0; i < 8; i++) {
+		const auto deadline = clock::now() + 1ms;
+		std::this_thread::sleep_until(deadline);
+		updateSlack(clock::now() - deadline);
+	}
+	spdlog::info("Sleep overshoots by {:.3f} ms ± {:.3f} ms, waking {:.3f} ms early",
+		oversleepMean_ * 1e-6, oversleepDev_ * 1e-6,
+		std::chrono::duration<double, std::milli>(slack_).count());
+}
+
+void FramePacer::updateSlack(clock::duration oversleep)
+{
+	const auto sample = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(oversleep).count());
+	oversleepMean_ += (sample - oversleepMean_) * slackAlpha;
+	oversleepDev_ += (std::abs(sample - oversleepMean_) - oversleepDev_) * slackAlpha;
+
+	const auto slack = std::chrono::nanoseconds(static_cast<int64_t>(oversleepMean_ + 3.0 * oversleepDev_));
+	slack_ = std::clamp<clock::duration>(slack, minSlack, std::max<clock::duration>(minSlack, period_ / 2));
+}
+
+void FramePacer::wait()
+{
+	if (policy_ == PacingPolicy::Fixed) {
+		auto now = clock::now();
+		// Too far behind to catch up without a burst of frames, start over from now
+		if (now - next_ > period_)
+			next_ = now;
+
+		const auto wakeup = next_ - slack_;
+		if (now < wakeup) {
+			const auto before = now;
+			std::this_thread::sleep_until(wakeup);
+			now = clock::now();
+			sleepTime_ += now - before;
+			updateSlack(now - wakeup);
+		}
+
+		const auto spinStart = now;
+		while (now < next_) {
+			cpuRelax();
+			now = clock::now();
+		}
+		spinTime_ += now - spinStart;
+		next_ += period_;
+	}
+
+	record(clock::now());
+}
+
+void FramePacer::record(clock::time_point frameStart)
+{
+	const double ms = std::chrono::duration<double, std::milli>(frameStart - lastFrame_).count();
+	lastFrame_ = frameStart;
+	frames_++;
+	sum_ += ms;
+	sumSq_ += ms * ms;
+
+	if (frameStart - windowStart_ < reportInterval)
+		return;
+
+	const auto n = static_cast<double>(frames_);
+	const double mean = sum_ / n;
+	stats_ = {
+		.frames = frames_,
+		.meanMs = mean,
+		.stddevMs = std::sqrt(std::max(0.0, sumSq_ / n - mean * mean)),
+		.sleepMs = std::chrono::duration<double, std::milli>(sleepTime_).count() / n,
+		.spinMs = std::chrono::duration<double, std::milli>(spinTime_).count() / n
+	};
+	spdlog::info("Frame pacing: {:.1f} fps, frame time {:.3f} ± {:.3f} ms, waited {:.3f} ms asleep and {:.3f} ms spinning per frame",
+		1000.0 / mean, stats_.meanMs, stats_.stddevMs, stats_.sleepMs, stats_.spinMs);
+
+	windowStart_ = frameStart;
+	frames_ = 0;
+	sum_ = sumSq_ = 0.0;
+	sleepTime_ = spinTime_ = {};
+}
+
+vk::PresentModeKHR FramePacer::choosePresentMode(const std::vector<vk::PresentModeKHR>& supported) const
+{
+	using enum vk::PresentModeKHR;
+	std::vector<vk::PresentModeKHR> preferred;
+	switch (policy_) {
+	case PacingPolicy::VSync:
+		preferred = { eFifo };
+		break;
+	case PacingPolicy::Fixed:
+		// The CPU paces, presentation must not block but should not tear either
+		preferred = { eMailbox, eImmediate, eFifoRelaxed };
+		break;
+	case PacingPolicy::Uncapped:
+		preferred = { eImmediate, eMailbox, eFifoRelaxed };
+		break;
+	}
+
+	for (const auto mode : preferred) {
+		if (std::find(supported.begin(), supported.end(), mode) != supported.end())
+			return mode;
+	}
+	// Always supported
+	return eFifo;
+}
+
+}
@@ -0,0 +1,76 @@
+//
+// Created by ocean on 3/16/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_FRAMEPACER_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_FRAMEPACER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "EngineConfig.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Decides when the next frame starts.
+/// Fixed rate pacing sleeps until shortly before the deadline and spins the
+/// rest, where "shortly" tracks how late the OS has been waking us up.
+class FramePacer
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Stats
+	{
+		uint64_t frames = 0;
+		double meanMs = 0.0;
+		double stddevMs = 0.0;
+		// Per frame, sleeping costs no CPU time but spinning does
+		double sleepMs = 0.0;
+		double spinMs = 0.0;
+	};
+
+	FramePacer(PacingPolicy policy, double targetFps);
+
+	/// Block until the next frame is due
+	void wait();
+
+	/// Present mode matching the policy out of what the surface supports
+	vk::PresentModeKHR choosePresentMode(const std::vector<vk::PresentModeKHR>& supported) const;
+
+	PacingPolicy policy() const { return policy_; }
+	/// Statistics over the last reporting window
+	const Stats& stats() const { return stats_; }
+
+private:
+	void calibrate();
+	void updateSlack(clock::duration oversleep);
+	void record(clock::time_point frameStart);
+
+	PacingPolicy policy_;
+	clock::duration period_;
+	clock::time_point next_;
+	clock::time_point lastFrame_;
+
+	// Wake up this long before the deadline, derived from the oversleep estimate
+	clock::duration slack_ = std::chrono::milliseconds(1);
+	double oversleepMean_ = 0.0;
+	double oversleepDev_ = 0.0;
+
+	// Current reporting window
+	clock::time_point windowStart_;
+	uint64_t frames_ = 0;
+	double sum_ = 0.0;
+	double sumSq_ = 0.0;
+	clock::duration sleepTime_ {};
+	clock::duration spinTime_ {};
+	Stats stats_;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_FRAMEPACER_HPP
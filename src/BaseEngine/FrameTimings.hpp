@@ -0,0 +1,25 @@
+//
+// Created by ocean on 3/4/22.
+//
+
+#ifndef FRAMETIMINGS_HPP
+#define FRAMETIMINGS_HPP
+
+#include <chrono>
+
+namespace VulkanPlayground {
+
+// CPU time spent in each stage of the last Presenter::Run
+struct FrameTimings
+{
+	// Includes waiting for the frame fence
+	std::chrono::nanoseconds acquire {};
+	std::chrono::nanoseconds record {};
+	std::chrono::nanoseconds submit {};
+	std::chrono::nanoseconds present {};
+};
+
+}
+
+
+#endif //FRAMETIMINGS_HPP
@@ -0,0 +1,121 @@
+//
+// Created by ocean on 3/6/22.
+//
+
+#include "GpuProfiler.hpp"
+
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+
+namespace VulkanPlayground
+{
+
+constexpr uint32_t unresolved = ~(0u);
+
+GpuProfiler::GpuProfiler(vk::Device device, vk::PhysicalDevice gpu, uint32_t queueFamily,
+	unsigned frames, uint32_t maxRegions)
+	: device_(device), maxQueries_(maxRegions * 2)
+{
+	const auto& limits = gpu.getProperties().limits;
+	const auto validBits = gpu.getQueueFamilyProperties()[queueFamily].timestampValidBits;
+	if (validBits == 0 || limits.timestampPeriod == 0.0f) {
+		spdlog::warn("Timestamps are not supported on the graphics queue, GPU profiling disabled");
+		return;
+	}
+	period_ = limits.timestampPeriod;
+	validMask_ = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	for (unsigned i = 0; i < frames; i++) {
+		pools_.push_back(device_.createQueryPool({
+			{},
+			vk::QueryType::eTimestamp,
+			maxQueries_
+		}));
+	}
+	frames_.resize(frames);
+	readback_.resize(maxQueries_);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (const auto& pool : pools_)
+		device_.destroy(pool);
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer cmd, unsigned frame)
+{
+	if (!enabled())
+		return;
+	current_ = frame % frames_.size();
+	resolve(current_);
+
+	auto& f = frames_[current_];
+	f.regions.clear();
+	f.queries = 0;
+	open_.clear();
+	cmd.resetQueryPool(pools_[current_], 0, maxQueries_);
+}
+
+void GpuProfiler::beginRegion(vk::CommandBuffer cmd, const char* name)
+{
+	if (!enabled())
+		return;
+	auto& f = frames_[current_];
+	if (f.queries + 2 > maxQueries_) {
+		// Out of queries, keep begin/end pairs balanced and drop the region
+		open_.push_back(unresolved);
+		return;
+	}
+	open_.push_back(static_cast<uint32_t>(f.regions.size()));
+	f.regions.push_back({name, f.queries, unresolved});
+	cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, pools_[current_], f.queries);
+	f.queries += 2;
+}
+
+void GpuProfiler::endRegion(vk::CommandBuffer cmd)
+{
+	if (!enabled() || open_.empty())
+		return;
+	const auto idx = open_.back();
+	open_.pop_back();
+	if (idx == unresolved)
+		return;
+	auto& region = frames_[current_].regions[idx];
+	region.end = region.begin + 1;
+	cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, pools_[current_], region.end);
+}
+
+void GpuProfiler::resolve(unsigned frame)
+{
+	auto& f = frames_[frame];
+	// Nothing is reported for a frame without results, rather than the previous one again
+	results_.clear();
+	if (f.queries == 0)
+		return;
+
+	// The frame fence has signaled, so the results are available without waiting
+	const auto result = device_.getQueryPoolResults(
+		pools_[frame], 0, f.queries,
+		f.queries * sizeof(uint64_t), readback_.data(), sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess) {
+		spdlog::warn("Timestamp queries of frame slot {} not ready: {}", frame, to_string(result));
+		return;
+	}
+
+	for (const auto& region : f.regions) {
+		if (region.end == unresolved)
+			continue;
+		const auto ticks = (readback_[region.end] - readback_[region.begin]) & validMask_;
+		results_.push_back({region.name, static_cast<double>(ticks) * period_ * 1e-6});
+	}
+
+	if (spdlog::should_log(spdlog::level::debug)) {
+		fmt::memory_buffer line;
+		for (const auto& r : results_)
+			fmt::format_to(std::back_inserter(line), " {} {:.3f}ms", r.name, r.ms);
+		spdlog::debug("GPU:{}", fmt::to_string(line));
+	}
+}
+
+}
@@ -0,0 +1,79 @@
+//
+// Created by ocean on 3/6/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_GPUPROFILER_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_GPUPROFILER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground
+{
+
+/// Timestamp queries bracketing named regions of a frame.
+/// Every frame in flight owns a query pool, which is read back the next
+/// time the same frame slot comes around, so resolving never stalls.
+class GpuProfiler
+{
+public:
+	struct Region
+	{
+		// Must outlive the frame, string literals are expected
+		const char* name;
+		double ms;
+	};
+
+	GpuProfiler(vk::Device device, vk::PhysicalDevice gpu, uint32_t queueFamily,
+		unsigned frames, uint32_t maxRegions = 32);
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	/// Collect what the previous user of this frame slot recorded and reset its pool.
+	/// Call after the fence of the frame has been waited on and outside of a render pass.
+	void beginFrame(vk::CommandBuffer cmd, unsigned frame);
+	void beginRegion(vk::CommandBuffer cmd, const char* name);
+	void endRegion(vk::CommandBuffer cmd);
+
+	/// Regions of the most recently resolved frame
+	const std::vector<Region>& results() const { return results_; }
+	bool enabled() const { return !pools_.empty(); }
+
+private:
+	struct Slot
+	{
+		const char* name;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	struct Frame
+	{
+		std::vector<Slot> regions;
+		uint32_t queries = 0;
+	};
+
+	void resolve(unsigned frame);
+
+	vk::Device device_;
+	double period_ = 0.0;
+	uint64_t validMask_ = 0;
+	uint32_t maxQueries_;
+
+	std::vector<vk::QueryPool> pools_;
+	std::vector<Frame> frames_;
+	unsigned current_ = 0;
+	// Indices into frames_[current_].regions of regions not yet ended
+	std::vector<uint32_t> open_;
+
+	std::vector<uint64_t> readback_;
+	std::vector<Region> results_;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_GPUPROFILER_HPP
@@ -0,0 +1,316 @@
+//
+// Created by ocean on 4/6/22.
+//
+
+#include "GpuScene.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr uint32_t workgroupSize = 64;
+constexpr uint32_t noObject = UINT32_MAX;
+
+}
+
+bool GpuScene::supported(const vk::PhysicalDeviceFeatures& features)
+{
+	// Many draws per call, each reading its instance through firstInstance
+	return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+}
+
+GpuScene::GpuScene(vk::Device device, vk::PhysicalDevice gpu, VmaAllocator allocator, PipelineCache& cache,
+	const ShaderPack& shaders, unsigned frames, uint32_t capacity, bool drawCount)
+	: device_(device), allocator_(allocator),
+	  capacity_(std::max(1u, std::min(capacity, gpu.getProperties().limits.maxDrawIndirectCount))),
+	  drawCount_(drawCount), frames_(frames)
+{
+	objects_ = createBuffer(sizeof(Object) * capacity_,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	for (auto& frame : frames_) {
+		frame.instances = createBuffer(sizeof(SceneInstance) * capacity_,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		frame.commands = createBuffer(sizeof(vk::DrawIndexedIndirectCommand) * capacity_,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+		VmaAllocationInfo countInfo;
+		frame.count = createBuffer(sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU, &countInfo);
+		frame.mappedCount = static_cast<uint32_t *>(countInfo.pMappedData);
+	}
+
+	std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+	for (uint32_t i = 0; i < bindings.size(); i++)
+		bindings[i] = {i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr};
+	setLayout_ = device_.createDescriptorSetLayout({ {}, bindings });
+	const vk::DescriptorPoolSize poolSize {vk::DescriptorType::eStorageBuffer, 4 * frames};
+	descriptorPool_ = device_.createDescriptorPool({ {}, frames, poolSize });
+	const std::vector<vk::DescriptorSetLayout> layouts(frames, setLayout_);
+	const auto sets = device_.allocateDescriptorSets({descriptorPool_, layouts});
+
+	std::vector<vk::WriteDescriptorSet> writes;
+	std::vector<std::array<vk::DescriptorBufferInfo, 4>> infos(frames);
+	for (unsigned i = 0; i < frames; i++) {
+		auto& frame = frames_[i];
+		frame.set = sets[i];
+		infos[i] = {{
+			{objects_.buffer, 0, VK_WHOLE_SIZE},
+			{frame.instances.buffer, 0, VK_WHOLE_SIZE},
+			{frame.commands.buffer, 0, VK_WHOLE_SIZE},
+			{frame.count.buffer, 0, VK_WHOLE_SIZE}
+		}};
+		writes.push_back({frame.set, 0, 0, vk::DescriptorType::eStorageBuffer, {}, infos[i]});
+	}
+	device_.updateDescriptorSets(writes, {});
+
+	const vk::PushConstantRange pushConstants {vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants)};
+	layout_ = device_.createPipelineLayout({ {}, setLayout_, pushConstants });
+	createPipeline(cache, shaders);
+	spdlog::info("GPU scene of {} objects, culled {}", capacity_,
+		drawCount_ ? "into drawIndexedIndirectCount" : "into zeroed indirect draws");
+}
+
+GpuScene::~GpuScene()
+{
+	for (const auto& frame : frames_) {
+		vmaDestroyBuffer(allocator_, frame.instances.buffer, frame.instances.alloc);
+		vmaDestroyBuffer(allocator_, frame.commands.buffer, frame.commands.alloc);
+		vmaDestroyBuffer(allocator_, frame.count.buffer, frame.count.alloc);
+	}
+	vmaDestroyBuffer(allocator_, objects_.buffer, objects_.alloc);
+	device_.destroy(pipeline_);
+	device_.destroy(layout_);
+	device_.destroy(descriptorPool_);
+	device_.destroy(setLayout_);
+}
+
+GpuScene::Buffer GpuScene::createBuffer(vk::DeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memory,
+	VmaAllocationInfo* info)
+{
+	const auto bufferCreate = VkBufferCreateInfo {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+	const VmaAllocationCreateInfo allocCreate = {
+		.flags = info ? VMA_ALLOCATION_CREATE_MAPPED_BIT : VmaAllocationCreateFlags {},
+		.usage = memory
+	};
+	VkBuffer buffer;
+	Buffer created;
+	if (vmaCreateBuffer(allocator_, &bufferCreate, &allocCreate, &buffer, &created.alloc, info) != VK_SUCCESS) {
+		spdlog::error("Failed to allocate GPU scene buffers");
+		std::terminate();
+	}
+	created.buffer = buffer;
+	return created;
+}
+
+void GpuScene::createPipeline(PipelineCache& cache, const ShaderPack& shaders)
+{
+	const auto code = shaders.find("cull.comp");
+	if (code.empty()) {
+		spdlog::error("The shader pack lacks cull.comp");
+		std::terminate();
+	}
+	auto module = device_.createShaderModuleUnique({ {}, code.size_bytes(), code.data() });
+	const vk::ComputePipelineCreateInfo info {
+		{},
+		{ {}, vk::ShaderStageFlagBits::eCompute, *module, "main" },
+		layout_
+	};
+	auto result = device_.createComputePipeline(cache.get(), info);
+	if (result.result != vk::Result::eSuccess) {
+		spdlog::error("Failed to create the culling pipeline: {}", to_string(result.result));
+		std::terminate();
+	}
+	pipeline_ = result.value;
+}
+
+uint32_t GpuScene::add(const MeshHandle& mesh, TextureHandle texture, const SpriteInstance& placement, float radius)
+{
+	// Empty objects mark free slots
+	if (mesh.indexCount == 0) {
+		spdlog::warn("GPU scene objects need a mesh with indices");
+		return noObject;
+	}
+	uint32_t object;
+	if (!free_.empty()) {
+		object = free_.back();
+		free_.pop_back();
+	} else if (used_ < capacity_) {
+		object = used_++;
+		mirror_.resize(used_);
+	} else {
+		spdlog::warn("GPU scene is full at {} objects", capacity_);
+		return noObject;
+	}
+
+	mirror_[object] = {
+		.position = placement.position,
+		.scale = placement.scale,
+		.uvRect = placement.uvRect,
+		.radius = radius,
+		.texture = texture.id,
+		.firstIndex = mesh.firstIndex,
+		.indexCount = mesh.indexCount,
+		.vertexOffset = static_cast<int32_t>(mesh.firstVertex)
+	};
+	dirty_.push_back(object);
+	live_++;
+	return object;
+}
+
+bool GpuScene::isLive(uint32_t object) const
+{
+	if (object < used_ && mirror_[object].indexCount != 0)
+		return true;
+	spdlog::warn("GPU scene has no object {}", object);
+	return false;
+}
+
+void GpuScene::move(uint32_t object, const SpriteInstance& placement)
+{
+	if (!isLive(object))
+		return;
+	auto& o = mirror_[object];
+	o.position = placement.position;
+	o.scale = placement.scale;
+	o.uvRect = placement.uvRect;
+	dirty_.push_back(object);
+}
+
+void GpuScene::remove(uint32_t object)
+{
+	if (!isLive(object))
+		return;
+	// Culling skips objects without indices, the slot is reused by a later add
+	mirror_[object].indexCount = 0;
+	dirty_.push_back(object);
+	free_.push_back(object);
+	live_--;
+}
+
+void GpuScene::upload(vk::CommandBuffer cmd, FrameArena& arena)
+{
+	std::sort(dirty_.begin(), dirty_.end());
+	dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+	// Up to a quarter of the arena, leaving the rest of the frame its room,
+	// the remaining objects follow in the next frames
+	const auto room = std::min(arena.capacity() - arena.used(), arena.capacity() / 4) / sizeof(Object);
+	const auto count = std::min<size_t>(dirty_.size(), room > 0 ? room - 1 : 0);
+	if (count == 0)
+		return;
+	const auto staged = arena.allocate(sizeof(Object) * count, alignof(Object));
+	if (!staged)
+		return;
+
+	copies_.clear();
+	for (size_t i = 0; i < count; i++) {
+		const auto offset = sizeof(Object) * i;
+		std::memcpy(staged.data + offset, &mirror_[dirty_[i]], sizeof(Object));
+		copies_.push_back({staged.offset + offset, sizeof(Object) * dirty_[i], sizeof(Object)});
+	}
+	dirty_.erase(dirty_.begin(), dirty_.begin() + static_cast<ptrdiff_t>(count));
+
+	// Earlier frames may still be culling from the objects
+	const vk::MemoryBarrier before {vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite};
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+		{}, before, {}, {});
+	cmd.copyBuffer(staged.buffer, objects_.buffer, copies_);
+}
+
+void GpuScene::cull(vk::CommandBuffer cmd, unsigned frame, FrameArena& arena, const glm::mat4& viewProj,
+	glm::vec2 viewCenter)
+{
+	auto& f = frames_[frame];
+	// The previous user of the slot has completed
+	if (f.culled) {
+		vmaInvalidateAllocation(allocator_, f.count.alloc, 0, sizeof(uint32_t));
+		stats_ = {f.submitted, *f.mappedCount};
+	}
+	f.submitted = live_;
+	f.culled = used_ > 0;
+
+	// Slots not uploaded yet must read as empty
+	if (!objectsCleared_) {
+		cmd.fillBuffer(objects_.buffer, 0, VK_WHOLE_SIZE, 0);
+		const vk::MemoryBarrier filled {vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite};
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+			{}, filled, {}, {});
+		objectsCleared_ = true;
+	}
+	if (!dirty_.empty())
+		upload(cmd, arena);
+	if (used_ == 0) {
+		stats_ = {};
+		return;
+	}
+
+	cmd.fillBuffer(f.count.buffer, 0, sizeof(uint32_t), 0);
+	// Draws past the count are skipped by the device, without it they must be empty
+	if (!drawCount_)
+		cmd.fillBuffer(f.commands.buffer, 0, sizeof(vk::DrawIndexedIndirectCommand) * used_, 0);
+	const vk::MemoryBarrier cleared {
+		vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+	};
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+		{}, cleared, {}, {});
+
+	// Gribb-Hartmann, rows of the matrix combined into inward facing planes
+	Constants constants;
+	const auto row = [&](int i) { return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]); };
+	constants.planes[0] = row(3) + row(0);
+	constants.planes[1] = row(3) - row(0);
+	constants.planes[2] = row(3) + row(1);
+	constants.planes[3] = row(3) - row(1);
+	// Depth is zero to one
+	constants.planes[4] = row(2);
+	constants.planes[5] = row(3) - row(2);
+	for (auto& plane : constants.planes)
+		plane /= glm::length(glm::vec3(plane));
+	constants.viewCenter = viewCenter;
+	constants.objectCount = used_;
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout_, 0, f.set, {});
+	cmd.pushConstants(layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+	cmd.dispatch((used_ + workgroupSize - 1) / workgroupSize, 1, 1);
+
+	// The count is also read back on the host once the frame fence signals,
+	// the fence alone does not make the shader's write visible there
+	const vk::MemoryBarrier culled {
+		vk::AccessFlagBits::eShaderWrite,
+		vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead
+			| vk::AccessFlagBits::eHostRead
+	};
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+		vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput
+			| vk::PipelineStageFlagBits::eHost,
+		{}, culled, {}, {});
+}
+
+void GpuScene::draw(vk::CommandBuffer cmd, unsigned frame) const
+{
+	if (used_ == 0)
+		return;
+	const auto& f = frames_[frame];
+	const vk::DeviceSize offset = 0;
+	cmd.bindVertexBuffers(VertexInput<SceneInstance>::layout.binding.binding, f.instances.buffer, offset);
+	constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+	if (drawCount_)
+		cmd.drawIndexedIndirectCount(f.commands.buffer, 0, f.count.buffer, 0, used_, stride);
+	else
+		cmd.drawIndexedIndirect(f.commands.buffer, 0, used_, stride);
+}
+
+}
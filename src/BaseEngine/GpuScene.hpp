@@ -0,0 +1,157 @@
+//
+// Created by ocean on 4/6/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_GPUSCENE_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_GPUSCENE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.h>
+
+#include "FrameArena.hpp"
+#include "GeometryStore.hpp"
+#include "PipelineCache.hpp"
+#include "ShaderPack.hpp"
+#include "TextureStreamer.hpp"
+#include "Vertex.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Objects that are culled and drawn without the CPU looking at them per frame.
+/// Their bounds and draw parameters live in a storage buffer. Every frame a
+/// compute pass tests them against the view frustum and compacts the visible
+/// ones into an indirect draw buffer and a SceneInstance buffer, which the
+/// graphics pass consumes with a single drawIndexedIndirectCount.
+///
+/// Changes to objects are copied into the storage buffer from the frame arena
+/// by the command buffer of the frame, so recording a frame costs the same
+/// however many objects there are.
+/// Without drawIndirectCount the command buffer is zeroed before culling and
+/// drawn in full, culled draws then have no instances.
+///
+/// Render thread only.
+class GpuScene
+{
+public:
+	struct Stats
+	{
+		// Objects culled, and drawn after culling
+		uint32_t submitted = 0;
+		uint32_t surviving = 0;
+	};
+
+	/// Whether the device has the indirect drawing features this needs
+	static bool supported(const vk::PhysicalDeviceFeatures& features);
+
+	/// drawCount when drawIndirectCount is enabled on the device.
+	/// capacity is clamped to the indirect draws the device allows.
+	GpuScene(vk::Device device, vk::PhysicalDevice gpu, VmaAllocator allocator, PipelineCache& cache,
+		const ShaderPack& shaders, unsigned frames, uint32_t capacity, bool drawCount);
+	~GpuScene();
+
+	GpuScene(const GpuScene&) = delete;
+	GpuScene& operator=(const GpuScene&) = delete;
+
+	/// radius bounds the mesh around its origin, before scaling.
+	/// Returns UINT32_MAX when the scene is full or the mesh is empty.
+	uint32_t add(const MeshHandle& mesh, TextureHandle texture, const SpriteInstance& placement,
+		float radius = 0.7072f);
+	/// Objects that are not live are logged and ignored
+	void move(uint32_t object, const SpriteInstance& placement);
+	void remove(uint32_t object);
+	uint32_t size() const { return live_; }
+	/// Changes not uploaded yet, a large add takes several frames
+	size_t pending() const { return dirty_.size(); }
+	uint32_t capacity() const { return capacity_; }
+
+	/// Upload the changes and cull. Outside a render pass, after the fence of frame
+	void cull(vk::CommandBuffer cmd, unsigned frame, FrameArena& arena, const glm::mat4& viewProj,
+		glm::vec2 viewCenter);
+	/// With a pipeline taking InstanceInput::Scene and the geometry bound
+	void draw(vk::CommandBuffer cmd, unsigned frame) const;
+
+	/// Counts of the last frame that completed on the GPU
+	const Stats& stats() const { return stats_; }
+
+private:
+	// std430 layout of cull.comp
+	struct Object
+	{
+		glm::vec2 position;
+		glm::vec2 scale;
+		glm::vec4 uvRect;
+		float radius;
+		uint32_t texture;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+		uint32_t padding[3];
+	};
+
+	struct Constants
+	{
+		glm::vec4 planes[6];
+		glm::vec2 viewCenter;
+		uint32_t objectCount;
+	};
+
+	struct Buffer
+	{
+		vk::Buffer buffer;
+		VmaAllocation alloc = nullptr;
+	};
+
+	struct Frame
+	{
+		Buffer instances;
+		Buffer commands;
+		// Host visible, read back once the frame has completed
+		Buffer count;
+		uint32_t* mappedCount = nullptr;
+		vk::DescriptorSet set;
+		// Objects live when the frame was recorded, and whether it culled any
+		uint32_t submitted = 0;
+		bool culled = false;
+	};
+
+	Buffer createBuffer(vk::DeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memory,
+		VmaAllocationInfo* info = nullptr);
+	void createPipeline(PipelineCache& cache, const ShaderPack& shaders);
+	void upload(vk::CommandBuffer cmd, FrameArena& arena);
+	bool isLive(uint32_t object) const;
+
+	vk::Device device_;
+	VmaAllocator allocator_;
+	uint32_t capacity_;
+	bool drawCount_;
+
+	vk::DescriptorSetLayout setLayout_;
+	vk::DescriptorPool descriptorPool_;
+	vk::PipelineLayout layout_;
+	vk::Pipeline pipeline_;
+
+	Buffer objects_;
+	bool objectsCleared_ = false;
+	std::vector<Frame> frames_;
+
+	// Mirror of the storage buffer, indexed by object
+	std::vector<Object> mirror_;
+	std::vector<uint32_t> free_;
+	// Slots below it have been handed out, culling covers them
+	uint32_t used_ = 0;
+	uint32_t live_ = 0;
+	// Objects to copy to the storage buffer in the next frame
+	std::vector<uint32_t> dirty_;
+	std::vector<vk::BufferCopy> copies_;
+
+	Stats stats_;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_GPUSCENE_HPP
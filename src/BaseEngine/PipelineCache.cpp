@@ -0,0 +1,213 @@
+//
+// Created by ocean on 3/9/22.
+//
+
+#include "PipelineCache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+constexpr std::array<char, 4> fileMagic { 'V', 'P', 'P', 'C' };
+constexpr uint32_t fileVersion = 1;
+// Keep adapting to driver updates instead of averaging over all history
+constexpr uint32_t maxMissSamples = 64;
+
+struct FileHeader
+{
+	std::array<char, 4> magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint32_t missSamples;
+	uint64_t missNanos;
+	uint64_t dataSize;
+	uint64_t checksum;
+};
+
+uint64_t fnv1a(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+}
+
+PipelineCache::PipelineCache(vk::Device device, vk::PhysicalDevice gpu, std::string path, bool creationFeedback)
+	: device_(device), props_(gpu.getProperties()), path_(std::move(path)), creationFeedback_(creationFeedback)
+{
+	std::vector<uint8_t> data;
+	if (!path_.empty() && !load(data))
+		data.clear();
+
+	cache_ = device_.createPipelineCache({
+		{},
+		data.size(),
+		data.data()
+	});
+}
+
+PipelineCache::~PipelineCache()
+{
+	device_.destroy(cache_);
+}
+
+bool PipelineCache::load(std::vector<uint8_t>& data)
+{
+	const auto file = std::fopen(path_.c_str(), "rb");
+	if (!file) {
+		spdlog::info("No pipeline cache at {}, starting cold", path_);
+		return false;
+	}
+
+	const auto reject = [&](const char* reason) {
+		spdlog::warn("Discarding pipeline cache {}: {}", path_, reason);
+		std::fclose(file);
+		return false;
+	};
+
+	FileHeader header;
+	if (std::fread(&header, sizeof(header), 1, file) != 1)
+		return reject("truncated header");
+	if (header.magic != fileMagic || header.version != fileVersion)
+		return reject("unknown format");
+	if (header.vendorID != props_.vendorID || header.deviceID != props_.deviceID
+		|| header.driverVersion != props_.driverVersion)
+		return reject("written by another device or driver");
+
+	std::fseek(file, 0, SEEK_END);
+	const auto size = std::ftell(file);
+	if (size < 0 || static_cast<uint64_t>(size) - sizeof(header) != header.dataSize)
+		return reject("truncated data");
+	std::fseek(file, sizeof(header), SEEK_SET);
+
+	data.resize(header.dataSize);
+	if (std::fread(data.data(), 1, data.size(), file) != data.size())
+		return reject("truncated data");
+	if (fnv1a(data.data(), data.size()) != header.checksum)
+		return reject("checksum mismatch");
+
+	// The driver validates this too, but some are known to crash on foreign data
+	VkPipelineCacheHeaderVersionOne vkHeader;
+	if (data.size() < sizeof(vkHeader))
+		return reject("truncated vulkan header");
+	std::memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+	if (vkHeader.headerSize < sizeof(vkHeader) || vkHeader.headerSize > data.size()
+		|| vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		|| vkHeader.vendorID != props_.vendorID || vkHeader.deviceID != props_.deviceID
+		|| std::memcmp(vkHeader.pipelineCacheUUID, props_.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0)
+		return reject("vulkan header does not match this device");
+
+	std::fclose(file);
+	missNanos_ = header.missNanos;
+	missSamples_ = header.missSamples;
+	spdlog::info("Loaded {} bytes of pipeline cache from {}", data.size(), path_);
+	return true;
+}
+
+vk::ResultValue<vk::Pipeline> PipelineCache::createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo& info)
+{
+	auto createInfo = info;
+	vk::PipelineCreationFeedbackEXT feedback;
+	std::vector<vk::PipelineCreationFeedbackEXT> stageFeedback(info.stageCount);
+	vk::PipelineCreationFeedbackCreateInfoEXT feedbackInfo;
+	if (creationFeedback_) {
+		feedbackInfo.setPPipelineCreationFeedback(&feedback)
+			.setPipelineStageCreationFeedbackCount(info.stageCount)
+			.setPPipelineStageCreationFeedbacks(stageFeedback.data())
+			.setPNext(createInfo.pNext);
+		createInfo.setPNext(&feedbackInfo);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	auto result = device_.createGraphicsPipeline(cache_, createInfo);
+	const auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count());
+	if (result.result != vk::Result::eSuccess)
+		return result;
+
+	using enum vk::PipelineCreationFeedbackFlagBitsEXT;
+	std::lock_guard lock(mutex_);
+	if (!creationFeedback_ || !(feedback.flags & eValid)) {
+		unknown_++;
+	} else if (feedback.flags & eApplicationPipelineCacheHit) {
+		hits_++;
+		hitNanos_ += elapsed;
+	} else {
+		misses_++;
+		missNanos_ = (missNanos_ * missSamples_ + elapsed) / (missSamples_ + 1);
+		missSamples_ = std::min(missSamples_ + 1, maxMissSamples);
+	}
+	return result;
+}
+
+void PipelineCache::save() const
+{
+	if (path_.empty())
+		return;
+
+	const auto data = device_.getPipelineCacheData(cache_);
+	std::unique_lock lock(mutex_);
+	FileHeader header = {
+		.magic = fileMagic,
+		.version = fileVersion,
+		.vendorID = props_.vendorID,
+		.deviceID = props_.deviceID,
+		.driverVersion = props_.driverVersion,
+		.missSamples = missSamples_,
+		.missNanos = missNanos_,
+		.dataSize = data.size(),
+		.checksum = fnv1a(data.data(), data.size())
+	};
+	lock.unlock();
+
+	// Never leave a half written cache behind if we die midway
+	const auto tmpPath = path_ + ".tmp";
+	const auto file = std::fopen(tmpPath.c_str(), "wb");
+	if (!file) {
+		spdlog::warn("Failed to open file: {}", tmpPath);
+		return;
+	}
+	const bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	if (std::fclose(file) != 0 || !written || std::rename(tmpPath.c_str(), path_.c_str()) != 0) {
+		spdlog::warn("Failed to write pipeline cache {}", path_);
+		std::remove(tmpPath.c_str());
+		return;
+	}
+	spdlog::info("Saved {} bytes of pipeline cache to {}", data.size(), path_);
+}
+
+void PipelineCache::report() const
+{
+	std::lock_guard lock(mutex_);
+	if (!creationFeedback_) {
+		spdlog::info("Pipeline cache: {} pipelines compiled, hit rate unknown without {}",
+			unknown_, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+		return;
+	}
+
+	const auto total = hits_ + misses_;
+	if (total == 0)
+		return;
+	const double expected = static_cast<double>(hits_) * static_cast<double>(missNanos_);
+	const double saved = std::max(0.0, expected - static_cast<double>(hitNanos_));
+	spdlog::info("Pipeline cache: {}/{} hits ({:.0f}%), about {:.2f} ms of compile time saved",
+		hits_, total, 100.0 * hits_ / total, saved * 1e-6);
+}
+
+}
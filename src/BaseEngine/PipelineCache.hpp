@@ -0,0 +1,67 @@
+//
+// Created by ocean on 3/9/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_PIPELINECACHE_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_PIPELINECACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace VulkanPlayground
+{
+
+/// vk::PipelineCache persisted across runs.
+/// The file is only accepted when it was written by the same device and
+/// driver, anything else (including truncated or corrupted files) starts
+/// from an empty cache.
+///
+/// Thread-safe, pipelines are compiled through it from the worker threads.
+class PipelineCache
+{
+public:
+	/// An empty path keeps the cache in memory only
+	PipelineCache(vk::Device device, vk::PhysicalDevice gpu, std::string path, bool creationFeedback);
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	/// Compile through the cache, recording whether it was hit and how long it took
+	vk::ResultValue<vk::Pipeline> createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo& info);
+
+	/// Write the cache back to its path, replacing the old file atomically
+	void save() const;
+	/// Log hit rate and estimated compile time saved so far
+	void report() const;
+
+	vk::PipelineCache get() const { return cache_; }
+
+private:
+	bool load(std::vector<uint8_t>& data);
+
+	vk::Device device_;
+	vk::PhysicalDeviceProperties props_;
+	std::string path_;
+	bool creationFeedback_;
+	vk::PipelineCache cache_;
+
+	// Guards the counters, the vk::PipelineCache synchronizes itself
+	mutable std::mutex mutex_;
+	// Average cost of compiling a pipeline that missed the cache, carried across runs
+	uint64_t missNanos_ = 0;
+	uint32_t missSamples_ = 0;
+
+	uint32_t hits_ = 0;
+	uint32_t misses_ = 0;
+	uint32_t unknown_ = 0;
+	uint64_t hitNanos_ = 0;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_PIPELINECACHE_HPP
@@ -0,0 +1,118 @@
+//
+// Created by ocean on 4/2/22.
+//
+
+#include "PipelineCompiler.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace VulkanPlayground
+{
+
+namespace {
+
+uint64_t fnv1a(std::span<const uint32_t> code)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const auto bytes = reinterpret_cast<const uint8_t *>(code.data());
+	for (size_t i = 0; i < code.size_bytes(); i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+double toMs(std::chrono::nanoseconds ns)
+{
+	return std::chrono::duration<double, std::milli>(ns).count();
+}
+
+}
+
+size_t PipelineCompiler::KeyHash::operator()(const Key& key) const
+{
+	// Handles only take part in equality, they are few
+	const std::hash<std::string_view> hash;
+	return hash(key.desc.vertex) ^ hash(key.desc.fragment) * 31 ^ key.vertex * 17 ^ key.fragment
+		^ static_cast<VkCullModeFlags>(key.desc.cullMode) << 3 ^ static_cast<size_t>(key.desc.instances) << 1 ^ key.desc.blend
+		^ static_cast<size_t>(key.desc.vertices) << 5;
+}
+
+PipelineCompiler::PipelineCompiler(vk::Device device, PipelineCache& cache, ThreadPool& pool)
+	: device_(device), cache_(cache), pool_(pool)
+{
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+	// Compiles take the lock when they finish, wait without it
+	std::vector<std::shared_future<vk::Pipeline>> futures;
+	{
+		std::lock_guard lock(mutex_);
+		for (const auto& [key, future] : pipelines_)
+			futures.push_back(future);
+	}
+	for (const auto& future : futures)
+		device_.destroy(future.get());
+}
+
+std::shared_future<vk::Pipeline> PipelineCompiler::compile(const PipelineDesc& desc, const ShaderPack& shaders)
+{
+	const Key key {desc, fnv1a(shaders.find(desc.vertex)), fnv1a(shaders.find(desc.fragment))};
+	std::lock_guard lock(mutex_);
+	auto& future = pipelines_[key];
+	// A failed compile is tried again
+	const bool failed = future.valid()
+		&& future.wait_for(std::chrono::seconds(0)) == std::future_status::ready && !future.get();
+	if (future.valid() && !failed) {
+		deduplicated_++;
+		return future;
+	}
+	// Startup and hot reload block on the pipelines, they go ahead of queued texture decodes
+	future = pool_.submit([this, key, &shaders] { return build(key, shaders); }, ThreadPool::Priority::Urgent).share();
+	return future;
+}
+
+vk::Pipeline PipelineCompiler::build(const Key& key, const ShaderPack& shaders)
+{
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	vk::Pipeline pipeline;
+	try {
+		const auto result = createGraphicsPipeline(device_, cache_, shaders, key.desc);
+		if (result.result == vk::Result::eSuccess)
+			pipeline = result.value;
+		else
+			spdlog::error("Failed to compile pipeline {}+{}: {}", key.desc.vertex, key.desc.fragment, to_string(result.result));
+	} catch (const vk::SystemError& e) {
+		// Invalid SPIR-V is rejected when creating the shader modules
+		spdlog::error("Failed to compile pipeline {}+{}: {}", key.desc.vertex, key.desc.fragment, e.what());
+	}
+	const auto end = clock::now();
+
+	std::lock_guard lock(mutex_);
+	compiled_++;
+	total_ += end - start;
+	longest_ = std::max<std::chrono::nanoseconds>(longest_, end - start);
+	if (firstStart_ == clock::time_point {} || start < firstStart_)
+		firstStart_ = start;
+	lastEnd_ = std::max(lastEnd_, end);
+	return pipeline;
+}
+
+void PipelineCompiler::report() const
+{
+	std::lock_guard lock(mutex_);
+	if (compiled_ == 0)
+		return;
+	spdlog::info("Compiled {} pipelines on {} threads ({} duplicate requests): {:.2f} ms of compile time, "
+		"{:.2f} ms critical path, {:.2f} ms wall",
+		compiled_, pool_.size(), deduplicated_, toMs(total_), toMs(longest_), toMs(lastEnd_ - firstStart_));
+}
+
+}
@@ -0,0 +1,84 @@
+//
+// Created by ocean on 4/2/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_PIPELINECOMPILER_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_PIPELINECOMPILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+#include <vulkan/vulkan.hpp>
+
+#include "DefaultPipeline.hpp"
+#include "PipelineCache.hpp"
+#include "ShaderPack.hpp"
+#include "ThreadPool.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Compiles graphics pipelines on the thread pool, all through one
+/// PipelineCache, handing out futures so the caller can go on meanwhile.
+/// A request identical to one already made, same description and same
+/// SPIR-V, shares its future instead of compiling again.
+///
+/// Pipelines are owned by the compiler and live as long as it does, which
+/// also makes going back to a previous shader edit instant.
+/// Thread-safe.
+class PipelineCompiler
+{
+public:
+	PipelineCompiler(vk::Device device, PipelineCache& cache, ThreadPool& pool);
+	/// Waits for compiles still running, then destroys every pipeline
+	~PipelineCompiler();
+
+	PipelineCompiler(const PipelineCompiler&) = delete;
+	PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+	/// shaders must outlive the compile. The future holds a null pipeline
+	/// when compiling failed, which is logged and tried again on the next request.
+	std::shared_future<vk::Pipeline> compile(const PipelineDesc& desc, const ShaderPack& shaders);
+
+	/// Log the compile time summed over every pipeline against the critical
+	/// path, the longest single compile, and the wall time they took
+	void report() const;
+
+private:
+	struct Key
+	{
+		PipelineDesc desc;
+		// Of the SPIR-V of each stage
+		uint64_t vertex;
+		uint64_t fragment;
+
+		bool operator==(const Key&) const = default;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	vk::Pipeline build(const Key& key, const ShaderPack& shaders);
+
+	vk::Device device_;
+	PipelineCache& cache_;
+	ThreadPool& pool_;
+
+	mutable std::mutex mutex_;
+	std::unordered_map<Key, std::shared_future<vk::Pipeline>, KeyHash> pipelines_;
+	uint32_t compiled_ = 0;
+	uint32_t deduplicated_ = 0;
+	std::chrono::nanoseconds total_ {};
+	std::chrono::nanoseconds longest_ {};
+	std::chrono::steady_clock::time_point firstStart_ {};
+	std::chrono::steady_clock::time_point lastEnd_ {};
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_PIPELINECOMPILER_HPP
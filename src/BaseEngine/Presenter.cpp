@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 
 #include <SDL_vulkan.h>
 #include <spdlog/spdlog.h>
@@ -13,24 +14,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "BaseEngine.hpp"
-#include "ShaderModule.hpp"
+#include "DefaultPipeline.hpp"
 
 namespace VulkanPlayground
 {
 
-constexpr static std::array<Vertex, 4> defaultVertices {
-	{
-		{{-0.5f, -0.5f}, {2.0f, 2.0f, 1.0f}},
-		{{-0.5f,  0.5f}, {2.0f, 0.0f, 1.0f}},
-		{{ 0.5f, -0.5f}, {0.0f, 2.0f, 1.0f}},
-		{{ 0.5f,  0.5f}, {0.0f, 0.0f, 1.0f}},
-	}
-};
-
-constexpr static std::array<uint32_t, 6> defaultIndexes {
-	0, 1, 2, 2, 1, 3
-};
-
 template<typename T, glm::qualifier Q>
 constexpr inline glm::mat<4, 4, T, Q> lookat(glm::vec<3, T, Q> const& eye, glm::vec<3, T, Q> const& center, glm::vec<3, T, Q> const& up)
 {
@@ -74,71 +62,36 @@ constexpr inline glm::mat<4, 4, T, glm::defaultp> perspect(T fovy, T aspect, T z
 
 static glm::vec2 norCenter;
 
-Presenter::Presenter(const BaseEngine& engine, Presenter* oldPresenter)
+Presenter::Presenter(const BaseEngine& engine)
 	: engine_(engine), device_(engine_.device_)
 	{
-		const auto& phyDevice = engine_.chosenGPU_;
-		const auto& surface = engine_.surface_;
-		const auto& format = engine_.surfaceFmt_;
-
-		// Determine Present mode
-		auto presentMode = vk::PresentModeKHR::eImmediate;
-		{
-			using enum vk::PresentModeKHR;
-			const auto& presentSup = phyDevice.getSurfacePresentModesKHR(surface);
-			if (std::find(presentSup.begin(), presentSup.end(), presentMode) == presentSup.end()) {
-				presentMode = eFifoRelaxed;
-				if (std::find(presentSup.begin(), presentSup.end(), presentMode) == presentSup.end()) {
-					presentMode = eFifo;
-				}
-			}
-			spdlog::debug("Using present mode {}", to_string(presentMode));
-		}
-
-		// Determine image extent
-		int w, h;
-		SDL_Vulkan_GetDrawableSize(engine_.window_, &w, &h);
-		extent_ = vk::Extent2D {(uint32_t)w, (uint32_t)h};
-		unsigned imgCnt = engine_.imageCount_;
-
-		const auto surfaceCap = phyDevice.getSurfaceCapabilitiesKHR(surface);
-		{
-			const auto &maxExt = surfaceCap.maxImageExtent;
-			const auto &minExt = surfaceCap.minImageExtent;
-			extent_.width = std::clamp(extent_.width, minExt.width, maxExt.width);
-			extent_.height = std::clamp(extent_.height, minExt.height, maxExt.height);
-		}
-
-		// Create swapchain
-		{
-			using enum vk::ImageUsageFlagBits;
-			using enum vk::SharingMode;
-			using enum vk::CompositeAlphaFlagBitsKHR;
-
-			std::array<uint32_t, 1> queueFamilies { engine_.graphicsQF_ };
-
-			swapchain_ = device_.createSwapchainKHR({
-				{},
-				surface,
-				imgCnt,
-				format.format,
-				format.colorSpace,
-				extent_,
-				1,
-				eColorAttachment | eTransferDst,
-				eExclusive,
-				queueFamilies,
-				surfaceCap.currentTransform,
-				eOpaque,
-				presentMode,
-				VK_TRUE,
-				(oldPresenter) ? (oldPresenter->swapchain_) : nullptr
-			});
+		renderPass_ = engine.renderPass_;
+		pipelineLayout_ = engine_.globalPipelineLayout_;
+		boundTextures_.assign(engine_.frames_.size(), engine_.textures_->placeholder());
+
+		// The pipelines compile on workers while the targets are created
+		const auto pipelines = engine_.compilePipelines(*engine_.shaders_);
+		createTargets(nullptr);
+		pipeline_ = pipelines[0].get();
+		spritePipeline_ = pipelines[1].get();
+		if (engine_.scene_)
+			scenePipeline_ = pipelines[2].get();
+		if (engine_.mesh_)
+			meshPipeline_ = pipelines[3].get();
+		if (!pipeline_ || !spritePipeline_ || (engine_.scene_ && !scenePipeline_) || (engine_.mesh_ && !meshPipeline_)) {
+			spdlog::error("Failed to create Graphics Pipeline!");
+			std::terminate();
 		}
+	}
 
-		renderPass_ = engine.renderPass_;
+	void Presenter::createTargets(vk::SwapchainKHR oldSwapchain)
+	{
+		const auto& format = engine_.surfaceFmt_;
 
-		images_ = device_.getSwapchainImagesKHR(swapchain_);
+		if (engine_.config_.headless)
+			createOffscreenImages();
+		else
+			createSwapchain(oldSwapchain);
 
 		// Per-image imageview and framebuffer from swapchain
 		for (const auto& image :images_) {
@@ -176,303 +129,265 @@ Presenter::Presenter(const BaseEngine& engine, Presenter* oldPresenter)
 					}));
 		}
 
-		pipelineLayout_ = engine_.globalPipelineLayout_;
+		// Per-image render completion, waited on by present
+		if (swapchain_) {
+			for (size_t i = 0; i < images_.size(); i++)
+				renderComplete_.push_back(device_.createSemaphore({}));
+		}
+		imageFences_.resize(images_.size());
 
-		// Create Graphics Pipeline
+		// Uploaded by every frame, frames in flight keep the one they were recorded with
 		{
-			auto vertCode = ShaderModule::readShader("assets/trig.vert.spv");
-			auto fragCode = ShaderModule::readShader("assets/trig.frag.spv");
-			auto vert = device_.createShaderModuleUnique(
-				{ {}, vertCode });
-			auto frag = device_.createShaderModuleUnique(
-				{ {}, fragCode });
-
-			vk::PipelineShaderStageCreateInfo shaderStage[] = {
-				{
-					{},
-					vk::ShaderStageFlagBits::eVertex,
-					*vert,
-					"main"
-				},
-				{
-					{},
-					vk::ShaderStageFlagBits::eFragment,
-					*frag,
-					"main"
-				}
-			};
-
-			vk::PipelineVertexInputStateCreateInfo vertexInput = {
-				{}, Vertex::vertexInputBinding, Vertex::vertexInputAttribute
-			};
-
-			vk::PipelineInputAssemblyStateCreateInfo inputAssembly = {
-				{}, vk::PrimitiveTopology::eTriangleList, VK_FALSE
-			};
-
-			vk::Viewport viewport = {
-				0.0f, 0.0f,
-				(float)extent_.width, (float)extent_.height,
-				0.0f, 1.0f
-			};
-
-			vk::Rect2D sessior = {{0, 0}, extent_};
-
-			vk::PipelineViewportStateCreateInfo viewportState = {
-				{}, viewport, sessior
-			};
-
-			vk::PipelineRasterizationStateCreateInfo rasterization;
-			rasterization.setCullMode(vk::CullModeFlagBits::eBack);
-			rasterization.setFrontFace(vk::FrontFace::eCounterClockwise);
-			rasterization.setLineWidth(1.0f);
-
-			vk::PipelineMultisampleStateCreateInfo multisample;
-			multisample.setRasterizationSamples(vk::SampleCountFlagBits::e1)
-				.setSampleShadingEnable(VK_FALSE);
-
-			vk::PipelineColorBlendAttachmentState colorBlendAttachment;
-			colorBlendAttachment.setBlendEnable(VK_FALSE)
-			.setColorWriteMask(
-				vk::ColorComponentFlagBits::eR |
-				vk::ColorComponentFlagBits::eG |
-				vk::ColorComponentFlagBits::eB |
-				vk::ColorComponentFlagBits::eA
-				);
-
-			vk::PipelineColorBlendStateCreateInfo colorBlend = {
-				{},
-				VK_FALSE, vk::LogicOp::eCopy,
-				colorBlendAttachment,
-				{1.0f, 1.0f, 1.0f, 1.0f}
-			};
+			glm::mat4 view2 = lookat(
+				glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1)
+			);
+			float aspect = (float)extent_.width/(float)extent_.height;
+			glm::mat4 proj2 = perspect(
+				90.0f, aspect, 0.5f, 10.0f
+			);
+			viewProj_ = proj2 * view2;
+		}
+	}
 
-			auto result = device_.createGraphicsPipeline(nullptr,
-				{
-					{},
-					2, shaderStage,
-					&vertexInput,
-					&inputAssembly,
-					nullptr,
-					&viewportState,
-					&rasterization,
-					&multisample,
-					nullptr,
-					&colorBlend,
-					nullptr,
-					pipelineLayout_,
-					renderPass_,
-					0,
-					VK_NULL_HANDLE,
-					0
-			});
+	void Presenter::destroyTargets()
+	{
+		for (auto & fb : swapchainFramebuffer_) {
+			device_.destroy(fb);
+		}
+		for (const auto& sem : renderComplete_) {
+			device_.destroy(sem);
+		}
+		for (const auto& imageV: imageViews_) {
+			device_.destroy(imageV);
+		}
+		for (size_t i = 0; i < offscreenAllocs_.size(); i++) {
+			vmaDestroyImage(engine_.vma_, images_[i], offscreenAllocs_[i]);
+		}
+		swapchainFramebuffer_.clear();
+		renderComplete_.clear();
+		imageViews_.clear();
+		offscreenAllocs_.clear();
+		images_.clear();
+		imageFences_.clear();
+	}
 
-			if (result.result != vk::Result::eSuccess) {
-				spdlog::error("Failed to create Graphics Pipeline!");
-				std::terminate();
-			}
-			pipeline_ = result.value;
+	void Presenter::resize()
+	{
+		// Only the frames that rendered to an image reference its framebuffer,
+		// the rest of the device keeps running
+		std::vector<vk::Fence> fences;
+		for (const auto& fence : imageFences_) {
+			if (fence && std::find(fences.begin(), fences.end(), fence) == fences.end())
+				fences.push_back(fence);
 		}
+		if (!fences.empty() && device_.waitForFences(fences, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess)
+			spdlog::error("fences not working!");
+		// Presents still in flight may wait on the semaphores and use the old
+		// swapchain past those fences, they go at the next resize
+		destroyRetired();
+		retiredSemaphores_ = std::move(renderComplete_);
+		renderComplete_.clear();
+		retiredSwapchain_ = swapchain_;
+
+		destroyTargets();
+		createTargets(retiredSwapchain_);
+	}
 
-		// Allocate Vertex Buffer
-		{
-			using enum vk::MemoryPropertyFlagBits;
-			VmaAllocationCreateInfo vmalloc = {
-				.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
-				.usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
-				.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			};
+	void Presenter::destroyRetired()
+	{
+		for (const auto& sem : retiredSemaphores_)
+			device_.destroy(sem);
+		retiredSemaphores_.clear();
+		if (retiredSwapchain_)
+			device_.destroy(retiredSwapchain_);
+		retiredSwapchain_ = nullptr;
+	}
 
-			auto bufferCreate = (VkBufferCreateInfo)vk::BufferCreateInfo {
-				{},
-				sizeof(Vertex) * defaultVertices.size(),
-				vk::BufferUsageFlagBits::eVertexBuffer,
-				vk::SharingMode::eExclusive
-			};
+	void Presenter::replacePipelines(vk::Pipeline quad, vk::Pipeline sprites, vk::Pipeline scene, vk::Pipeline mesh)
+	{
+		pipeline_ = quad;
+		spritePipeline_ = sprites;
+		scenePipeline_ = scene;
+		meshPipeline_ = mesh;
+	}
 
-			VkBuffer buffer;
-			VmaAllocationInfo bufferAllocInfo;
-			auto result = vmaCreateBuffer(
-				engine_.vma_,
-				&bufferCreate,
-				&vmalloc,
-				&buffer,
-				&vertexBufferAlloc_,
-				&bufferAllocInfo
-				);
+	void Presenter::createSwapchain(vk::SwapchainKHR oldSwapchain)
+	{
+		const auto& phyDevice = engine_.chosenGPU_;
+		const auto& surface = engine_.surface_;
+		const auto& format = engine_.surfaceFmt_;
 
-			if (result != VK_SUCCESS) {
-				spdlog::error("Falied to allocate buffer");
-				std::terminate();
-			}
+		// Determine Present mode
+		const auto presentMode = engine_.pacer_.choosePresentMode(phyDevice.getSurfacePresentModesKHR(surface));
+		spdlog::debug("Using present mode {}", to_string(presentMode));
 
-			vertexBuffer_ = buffer;
+		// Determine image extent
+		int w, h;
+		SDL_Vulkan_GetDrawableSize(engine_.window_, &w, &h);
+		extent_ = vk::Extent2D {(uint32_t)w, (uint32_t)h};
+		unsigned imgCnt = engine_.imageCount_;
 
-			memcpy(bufferAllocInfo.pMappedData, &defaultVertices, sizeof(Vertex) * defaultVertices.size());
-			vmaFlushAllocation(engine_.vma_, vertexBufferAlloc_, bufferAllocInfo.offset, bufferAllocInfo.size);
+		const auto surfaceCap = phyDevice.getSurfaceCapabilitiesKHR(surface);
+		{
+			const auto &maxExt = surfaceCap.maxImageExtent;
+			const auto &minExt = surfaceCap.minImageExtent;
+			extent_.width = std::clamp(extent_.width, minExt.width, maxExt.width);
+			extent_.height = std::clamp(extent_.height, minExt.height, maxExt.height);
 		}
 
-		// Allocate Index buffer
+		// Create swapchain
 		{
-			VkBuffer staging;
-			VmaAllocation stagingAlloc;
-			VmaAllocationInfo stagingAllocInfo;
-
-			const auto stagingCreate = VkBufferCreateInfo {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-				.size = defaultIndexes.size() * sizeof(defaultIndexes[0]),
-				.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				.sharingMode = VK_SHARING_MODE_EXCLUSIVE
-			};
-			const VmaAllocationCreateInfo stagingAllocCreate = {
-				.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
-				.usage = VMA_MEMORY_USAGE_CPU_ONLY,
-				.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-			};
+			using enum vk::ImageUsageFlagBits;
+			using enum vk::SharingMode;
+			using enum vk::CompositeAlphaFlagBitsKHR;
 
-			auto result = vmaCreateBuffer(
-				engine_.vma_,
-				&stagingCreate,
-				&stagingAllocCreate,
-				&staging,
-				&stagingAlloc,
-				&stagingAllocInfo
-			);
-			if (result != VK_SUCCESS) {
-				spdlog::error("Falied to allocate buffer");
-				std::terminate();
-			}
-			const size_t indexsize = sizeof(defaultIndexes[0]) * defaultIndexes.size();
-			memcpy(stagingAllocInfo.pMappedData, &defaultIndexes, indexsize);
+			std::array<uint32_t, 1> queueFamilies { engine_.graphicsQF_ };
 
+			swapchain_ = device_.createSwapchainKHR({
+				{},
+				surface,
+				imgCnt,
+				format.format,
+				format.colorSpace,
+				extent_,
+				1,
+				eColorAttachment | eTransferDst,
+				eExclusive,
+				queueFamilies,
+				surfaceCap.currentTransform,
+				eOpaque,
+				presentMode,
+				VK_TRUE,
+				oldSwapchain
+			});
+		}
 
-			VkBuffer index;
+		images_ = device_.getSwapchainImagesKHR(swapchain_);
+	}
 
-			const auto indexCreate = VkBufferCreateInfo {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-				.size = defaultIndexes.size() * sizeof(defaultIndexes[0]),
-				.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				.sharingMode = VK_SHARING_MODE_EXCLUSIVE
-			};
-			const VmaAllocationCreateInfo indexAllocCreate = {
-				.usage = VMA_MEMORY_USAGE_GPU_ONLY,
-				.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-			};
+	void Presenter::createOffscreenImages()
+	{
+		const auto& size = engine_.winSize_;
+		extent_ = vk::Extent2D {(uint32_t)size[0], (uint32_t)size[1]};
+
+		const auto imageCreate = (VkImageCreateInfo)vk::ImageCreateInfo {
+			{},
+			vk::ImageType::e2D,
+			engine_.surfaceFmt_.format,
+			vk::Extent3D { extent_.width, extent_.height, 1u },
+			1u,
+			1u,
+			vk::SampleCountFlagBits::e1,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc
+		};
+		const VmaAllocationCreateInfo imageAllocCreate = {
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+			.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		};
 
-			result = vmaCreateBuffer(
+		for (unsigned i = 0; i < engine_.imageCount_; i++) {
+			VkImage image;
+			VmaAllocation alloc;
+			const auto result = vmaCreateImage(
 				engine_.vma_,
-				&indexCreate,
-				&indexAllocCreate,
-				&index,
-				&indexBufferAlloc_,
+				&imageCreate,
+				&imageAllocCreate,
+				&image,
+				&alloc,
 				nullptr
-			);
-			if (result != VK_SUCCESS) {
-				vmaDestroyBuffer(engine_.vma_, staging, stagingAlloc);
-				spdlog::error("Falied to allocate buffer");
-				std::terminate();
-			}
-
-			const auto& cmdbufAlloc = device_.allocateCommandBuffers(
-				{
-					engine_.graphicsCmdPool_,
-					vk::CommandBufferLevel::ePrimary,
-					1
-				}
 				);
-			const auto& cmdbuf = cmdbufAlloc.front();
-			cmdbuf.begin(vk::CommandBufferBeginInfo {});
-			cmdbuf.copyBuffer(staging, index, { { 0, 0, indexsize } });
-			cmdbuf.end();
-			engine_.graphicsQ_.submit({ {{}, {}, cmdbufAlloc, {}} });
-			engine_.graphicsQ_.waitIdle();
-
-			indexBuffer_ = index;
-			vmaDestroyBuffer(engine_.vma_, staging, stagingAlloc);
-			device_.freeCommandBuffers(engine_.graphicsCmdPool_, cmdbufAlloc);
-		}
-
-		// Allocate command buffer
-		{
-			vk::CommandBufferAllocateInfo cmdBufferAllocInfo = {
-				engine_.graphicsCmdPool_,
-				vk::CommandBufferLevel::ePrimary,
-				2
-			};
-			auto result = device_.allocateCommandBuffers(
-				&cmdBufferAllocInfo,
-				cmdBuffer_.data()
-				);
-			if (result != vk::Result::eSuccess) {
-				spdlog::error("Failed to allocate command buffers");
+			if (result != VK_SUCCESS) {
+				spdlog::error("Failed to allocate offscreen image");
 				std::terminate();
 			}
-		}
-
-		// Update View Uniform
-		{
-			glm::mat4 view2 = lookat(
-				glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1)
-			);
-			float aspect = (float)extent_.width/(float)extent_.height;
-			glm::mat4 proj2 = perspect(
-				90.0f, aspect, 0.5f, 10.0f
-			);
-
-			void* uniform;
-			vmaMapMemory(engine_.vma_, engine_.viewAlloc_, &uniform);
-			*(glm::mat4 *)uniform = proj2 * view2;
-			vmaUnmapMemory(engine_.vma_, engine_.viewAlloc_);
+			images_.emplace_back(image);
+			offscreenAllocs_.push_back(alloc);
 		}
 	}
 
 	Presenter::~Presenter()
 	{
 		device_.waitIdle();
-		vmaDestroyBuffer(engine_.vma_, (VkBuffer)indexBuffer_, indexBufferAlloc_);
-		vmaDestroyBuffer(engine_.vma_, (VkBuffer)vertexBuffer_, vertexBufferAlloc_);
-		for (auto & fb : swapchainFramebuffer_) {
-			device_.destroy(fb);
-		}
-		device_.destroy(pipeline_);
-		for (const auto& imageV: imageViews_) {
-			device_.destroy(imageV);
-		}
-		device_.destroy(swapchain_);
+		destroyRetired();
+		destroyTargets();
+		if (swapchain_)
+			device_.destroy(swapchain_);
 	}
 
-	bool Presenter::Run()
+	Presenter::FrameResult Presenter::Run()
 	{
-		unsigned int theFrame = frameCnt % 2;
-		auto spin = glm::vec2{0.0f, 0.0f};
+		using clock = std::chrono::steady_clock;
+		const auto acquireStart = clock::now();
+		const unsigned int theFrame = frameCnt % engine_.frames_.size();
+		const auto& frame = engine_.frames_[theFrame];
+		const auto& imageAvailable = frame.imageAvailable;
+		const auto& imageDone = frame.frameDone;
 
-		const auto& [renderComplete, imageAvailable, imageDone] = engine_.syncObjs_[theFrame];
 		auto result1 = device_.waitForFences(1, &imageDone, VK_TRUE, UINT64_MAX);
 		if (result1 != vk::Result::eSuccess) {
 			spdlog::error("fences not working!");
-			return true;
+			return FrameResult::OutOfDate;
 		}
 
-		auto result2 = device_.acquireNextImageKHR(swapchain_, UINT64_MAX, imageAvailable, VK_NULL_HANDLE);
+		// Every frame up to the previous user of this slot has retired
+		const uint64_t framesInFlight = engine_.frames_.size();
+		const uint64_t oldestInFlight = frameCnt + 1 >= framesInFlight ? frameCnt + 1 - framesInFlight : 0;
+		engine_.geometry_->beginFrame(frameCnt, oldestInFlight);
+		auto& arena = *engine_.frameArena_;
+		arena.beginFrame(theFrame);
+
+		// The descriptor set is idle now that frameDone signaled
+		engine_.staging_->collect();
+		engine_.textures_->update();
+		// Textures are reached through the table, nothing is bound per texture
+		vk::DescriptorSet textureTable;
+		if (engine_.bindless_)
+			textureTable = engine_.bindless_->beginFrame(theFrame);
+		const auto texture = engine_.textures_->view(engine_.mainTexture_);
+		auto& boundTexture = boundTextures_[theFrame];
+		if (!engine_.bindless_ && boundTexture != texture) {
+			const vk::DescriptorImageInfo image { engine_.sampler_, texture, vk::ImageLayout::eShaderReadOnlyOptimal };
+			const vk::WriteDescriptorSet write {
+				frame.globalDescriptor, 0, 0, vk::DescriptorType::eCombinedImageSampler, image
+			};
+			device_.updateDescriptorSets(write, {});
+			boundTexture = texture;
+		}
 
-		if (result2.result != vk::Result::eSuccess) {
-			if (result2.result == vk::Result::eSuboptimalKHR) {
-				spdlog::info("Get suboptimal framebuffer image");
-			} else if (result2.result == vk::Result::eErrorOutOfDateKHR) {
-				spdlog::warn("Image out of date");
-				return true;
-			} else {
-				spdlog::error("Image acquire error: {}", to_string(result2.result));
-				std::terminate();
+		uint32_t curimg;
+		if (swapchain_) {
+			auto result2 = device_.acquireNextImageKHR(swapchain_, UINT64_MAX, imageAvailable, VK_NULL_HANDLE);
+
+			if (result2.result != vk::Result::eSuccess) {
+				if (result2.result == vk::Result::eSuboptimalKHR) {
+					spdlog::info("Get suboptimal framebuffer image");
+				} else if (result2.result == vk::Result::eErrorOutOfDateKHR) {
+					spdlog::warn("Image out of date");
+					return FrameResult::OutOfDate;
+				} else {
+					spdlog::error("Image acquire error: {}", to_string(result2.result));
+					std::terminate();
+				}
 			}
+			curimg = result2.value;
+		} else {
+			// Offscreen images are handed out round-robin
+			curimg = frameCnt % images_.size();
 		}
-		auto curimg = result2.value;
-		if (curimg != 0 && curimg != 1) {
-			spdlog::warn("Incorrect assumption about iamge index");
+
+		// With fewer images than frames in flight, another frame may still be rendering to it
+		auto& imageFence = imageFences_[curimg];
+		if (imageFence && imageFence != imageDone) {
+			result1 = device_.waitForFences(1, &imageFence, VK_TRUE, UINT64_MAX);
+			if (result1 != vk::Result::eSuccess) {
+				spdlog::error("fences not working!");
+				return FrameResult::OutOfDate;
+			}
 		}
+		imageFence = imageDone;
 
-		auto& cmdbuf = cmdBuffer_[curimg % 2];
+		const auto& cmdbuf = frame.cmdBuffer;
 		std::array<vk::ClearValue, 1> clearColor = {
 			{
 				vk::ClearColorValue {
@@ -480,11 +395,26 @@ Presenter::Presenter(const BaseEngine& engine, Presenter* oldPresenter)
 				}
 			}};
 
+		const auto view = arena.uniform(viewProj_);
+		const uint32_t viewOffset = static_cast<uint32_t>(view.offset);
+
 		const auto & viewCenter = engine_.modelCenter_;
 		norCenter[0] = static_cast<float>(viewCenter[0]) / 100.0f;
 		norCenter[1] = static_cast<float>(viewCenter[1]) / 100.0f;
 
-		cmdbuf.begin(vk::CommandBufferBeginInfo {});
+		const auto recordStart = clock::now();
+		auto& profiler = *engine_.profiler_;
+		// Everything recorded from this pool was retired by the frame fence
+		device_.resetCommandPool(frame.cmdPool);
+		cmdbuf.begin(vk::CommandBufferBeginInfo {vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+		profiler.beginFrame(cmdbuf, theFrame);
+		auto& scene = engine_.scene_;
+		if (scene) {
+			profiler.beginRegion(cmdbuf, "cull");
+			scene->cull(cmdbuf, theFrame, arena, viewProj_, norCenter);
+			profiler.endRegion(cmdbuf);
+		}
+		profiler.beginRegion(cmdbuf, "main");
 		cmdbuf.beginRenderPass(
 			{
 				renderPass_,
@@ -498,18 +428,52 @@ Presenter::Presenter(const BaseEngine& engine, Presenter* oldPresenter)
 			vk::PipelineBindPoint::eGraphics,
 			pipeline_
 			);
-		std::array<vk::Buffer, 1> vertexBuffers = {{ vertexBuffer_ }};
-		std::array<vk::DeviceSize, 1> offsets = {{ 0 }};
-		cmdbuf.bindVertexBuffers(0, vertexBuffers, offsets);
-		cmdbuf.bindIndexBuffer(indexBuffer_, 0u, vk::IndexType::eUint32);
-		cmdbuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout_, 0, 1, &engine_.globalDescriptors_[curimg%2], 0, nullptr);
-		cmdbuf.pushConstants(pipelineLayout_, vk::ShaderStageFlagBits::eVertex, 0, sizeof(norCenter), &norCenter);
-		cmdbuf.drawIndexed(6, 1, 0, 0, 0);
+		const vk::Viewport viewport = {
+			0.0f, 0.0f,
+			(float)extent_.width, (float)extent_.height,
+			0.0f, 1.0f
+		};
+		const vk::Rect2D scissor = {{0, 0}, extent_};
+		cmdbuf.setViewport(0, viewport);
+		cmdbuf.setScissor(0, scissor);
+		auto& geometry = *engine_.geometry_;
+		geometry.bind(cmdbuf);
+		const std::array sets {frame.globalDescriptor, textureTable};
+		cmdbuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout_, 0,
+			textureTable ? 2 : 1, sets.data(), 1, &viewOffset);
+		const QuadConstants constants {{norCenter[0], norCenter[1]}, engine_.mainTexture_.id};
+		cmdbuf.pushConstants(pipelineLayout_, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+			0, sizeof(constants), &constants);
+		geometry.draw(cmdbuf, engine_.quadMesh_);
+		if (scene) {
+			// Same layout, the descriptor sets and push constants stay valid
+			cmdbuf.bindPipeline(vk::PipelineBindPoint::eGraphics, scenePipeline_);
+			scene->draw(cmdbuf, theFrame);
+		}
+		if (!engine_.sprites_.empty()) {
+			// Same layout, the descriptor sets stay bound
+			cmdbuf.bindPipeline(vk::PipelineBindPoint::eGraphics, spritePipeline_);
+			engine_.sprites_.record(cmdbuf, arena, geometry, engine_.quadMesh_, pipelineLayout_, norCenter);
+		}
+		if (engine_.mesh_) {
+			// Same layout, only the vertex buffer and the push constants change
+			const auto& bounds = engine_.meshBounds_;
+			const MeshConstants meshConstants {constants, 0.0f, {bounds.x, bounds.y, bounds.z, bounds.w}};
+			cmdbuf.bindPipeline(vk::PipelineBindPoint::eGraphics, meshPipeline_);
+			geometry.bind(cmdbuf, VertexStream::Mesh);
+			cmdbuf.pushConstants(pipelineLayout_, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+				0, sizeof(meshConstants), &meshConstants);
+			geometry.draw(cmdbuf, engine_.mesh_);
+		}
 		cmdbuf.endRenderPass();
+		profiler.endRegion(cmdbuf);
 		cmdbuf.end();
 
+		const auto submitStart = clock::now();
+		arena.flush();
 		std::array<vk::Semaphore, 1> waitSem = {{ imageAvailable }};
 		std::array<vk::PipelineStageFlags, 1> waitStage = {{vk::PipelineStageFlagBits::eColorAttachmentOutput}};
+		const auto renderComplete = swapchain_ ? renderComplete_[curimg] : vk::Semaphore {};
 		std::array<vk::Semaphore, 1> signalS = {{ renderComplete }};
 		std::array<vk::CommandBuffer, 1> submitCmd = {{cmdbuf}};
 		std::array<vk::SubmitInfo, 1> submit = {
@@ -520,10 +484,22 @@ Presenter::Presenter(const BaseEngine& engine, Presenter* oldPresenter)
 				 signalS
 			 }}
 		};
+		// Nothing acquires or presents offscreen images, so no semaphore is involved
+		if (!swapchain_) {
+			submit[0].setWaitSemaphoreCount(0)
+				.setSignalSemaphoreCount(0);
+		}
 		std::array<vk::Fence, 1> fenceReset = {{imageDone}};
 		device_.resetFences(fenceReset);
 		engine_.graphicsQ_.submit(submit, imageDone);
 		frameCnt++;
+		const auto presentStart = clock::now();
+		timings_.acquire = recordStart - acquireStart;
+		timings_.record = submitStart - recordStart;
+		timings_.submit = presentStart - submitStart;
+		timings_.present = {};
+		if (!swapchain_)
+			return FrameResult::Presented;
 		try {
 			result1 = engine_.graphicsQ_.presentKHR(
 				{
@@ -531,15 +507,16 @@ Presenter::Presenter(const BaseEngine& engine, Presenter* oldPresenter)
 					1, &swapchain_,
 					&curimg, nullptr
 				});
+			timings_.present = clock::now() - presentStart;
 			if (result1 != vk::Result::eSuccess) {
 				spdlog::info("Get suboptimal result");
-				return true;
+				return FrameResult::Suboptimal;
 			}
 		} catch (vk::OutOfDateKHRError& e) {
 			spdlog::info("Get out of date image");
-			return true;
+			return FrameResult::OutOfDate;
 		}
 
-		return false;
+		return FrameResult::Presented;
 	}
 }
@@ -7,10 +7,11 @@
 
 #include <cstdint>
 
+#include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc.h>
 
-#include "Vertex.hpp"
+#include "FrameTimings.hpp"
 
 namespace VulkanPlayground
 {
@@ -19,7 +20,7 @@ namespace VulkanPlayground
 	class Presenter
 	{
 	public:
-		Presenter(const BaseEngine& engine, Presenter* oldPresenter);
+		explicit Presenter(const BaseEngine& engine);
 		virtual ~Presenter();
 
 		Presenter(const Presenter&) = delete;
@@ -27,32 +28,67 @@ namespace VulkanPlayground
 		Presenter& operator=(const Presenter&) = delete;
 		Presenter& operator=(Presenter&&) = delete;
 
-		bool Run();
+		enum class FrameResult
+		{
+			Presented,
+			// Presented, but the swapchain no longer matches the surface
+			Suboptimal,
+			// Nothing was presented, the swapchain must be rebuilt first
+			OutOfDate,
+		};
+
+		FrameResult Run();
+		/// Recreate the swapchain and everything sized by it.
+		/// The pipeline and geometry are kept, viewport and scissor are dynamic.
+		void resize();
+		/// Draw with these pipelines from the next frame on.
+		/// Pipelines belong to the PipelineCompiler, frames in flight keep the old ones.
+		void replacePipelines(vk::Pipeline quad, vk::Pipeline sprites, vk::Pipeline scene, vk::Pipeline mesh);
 
 	private:
+		void createTargets(vk::SwapchainKHR oldSwapchain);
+		void destroyTargets();
+		void destroyRetired();
+		void createSwapchain(vk::SwapchainKHR oldSwapchain);
+		void createOffscreenImages();
+
 		const BaseEngine& engine_;
 		const vk::Device& device_;
 
 		vk::SwapchainKHR swapchain_;
 		std::vector<vk::Image> images_;
+		// Backing memory of images_ in headless mode
+		std::vector<VmaAllocation> offscreenAllocs_;
 		std::vector<vk::ImageView> imageViews_;
 		std::vector<vk::Framebuffer> swapchainFramebuffer_;
 
 		vk::RenderPass renderPass_;
 		vk::PipelineLayout pipelineLayout_;
+		// Owned by the PipelineCompiler
 		vk::Pipeline pipeline_;
-
-		vk::Buffer vertexBuffer_;
-		VmaAllocation vertexBufferAlloc_;
-
-		vk::Buffer indexBuffer_;
-		VmaAllocation indexBufferAlloc_;
-
-		std::array<vk::CommandBuffer, 2> cmdBuffer_;
+		vk::Pipeline spritePipeline_;
+		// Null without a GpuScene
+		vk::Pipeline scenePipeline_;
+		// Null without a mesh
+		vk::Pipeline meshPipeline_;
+
+		// Indexed by image, signaled by rendering and waited on by present
+		std::vector<vk::Semaphore> renderComplete_;
+		// Replaced by the last resize, kept until the next one
+		std::vector<vk::Semaphore> retiredSemaphores_;
+		vk::SwapchainKHR retiredSwapchain_;
+		// Fence of the frame that last rendered to each image
+		std::vector<vk::Fence> imageFences_;
+		// Indexed by frame in flight, what its global descriptor samples,
+		// swapped to the real texture once it is uploaded
+		std::vector<vk::ImageView> boundTextures_;
 
 		vk::Extent2D extent_;
+		// Projection for the extent, written to the frame arena every frame
+		glm::mat4 viewProj_;
 
-		unsigned int frameCnt;
+		unsigned int frameCnt = 0;
+		FrameTimings timings_;
 
 		friend BaseEngine;
 	};
@@ -0,0 +1,74 @@
+//
+// Created by ocean on 4/1/22.
+//
+
+#include "ShaderWatcher.hpp"
+
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanPlayground
+{
+
+ShaderWatcher::ShaderWatcher(const std::string& path)
+{
+#ifdef __linux__
+	const std::filesystem::path file(path);
+	name_ = file.filename().string();
+	const auto directory = file.has_parent_path() ? file.parent_path().string() : std::string(".");
+
+	fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd_ < 0 || inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		spdlog::warn("Not watching {} for shader changes: {}", path, std::strerror(errno));
+		if (fd_ >= 0)
+			close(fd_);
+		fd_ = -1;
+		return;
+	}
+	spdlog::info("Watching {} for shader changes", path);
+#else
+	spdlog::warn("Not watching {} for shader changes, only supported on Linux", path);
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+	if (fd_ >= 0)
+		close(fd_);
+#endif
+}
+
+bool ShaderWatcher::changed()
+{
+	bool changed = false;
+#ifdef __linux__
+	if (fd_ < 0)
+		return false;
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		const auto size = read(fd_, buffer, sizeof(buffer));
+		// EAGAIN once drained
+		if (size <= 0)
+			break;
+		for (ssize_t offset = 0; offset < size;) {
+			const auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+			// Writes to the temporary file next to it are not a change yet
+			if (event->len && name_ == event->name)
+				changed = true;
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+#endif
+	return changed;
+}
+
+}
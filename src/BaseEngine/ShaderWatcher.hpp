@@ -0,0 +1,35 @@
+//
+// Created by ocean on 4/1/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_SHADERWATCHER_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_SHADERWATCHER_HPP
+
+#include <string>
+
+namespace VulkanPlayground
+{
+
+/// Notices the shaders target writing a new shader pack, through inotify.
+/// The directory is watched rather than the file, as the pack is replaced by
+/// a rename. Only Linux is supported, elsewhere nothing is ever reported.
+class ShaderWatcher
+{
+public:
+	explicit ShaderWatcher(const std::string& path);
+	~ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	/// Whether the pack was replaced since the last call, never blocks
+	bool changed();
+
+private:
+	int fd_ = -1;
+	std::string name_;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_SHADERWATCHER_HPP
@@ -0,0 +1,78 @@
+//
+// Created by ocean on 4/5/22.
+//
+
+#include "SpriteBatch.hpp"
+
+#include <cstring>
+
+#include "DefaultPipeline.hpp"
+
+namespace VulkanPlayground
+{
+
+void SpriteBatch::clear()
+{
+	for (size_t i = 0; i < used_; i++)
+		batches_[i].sprites.clear();
+	used_ = 0;
+	last_ = 0;
+	count_ = 0;
+}
+
+void SpriteBatch::add(TextureHandle texture, const SpriteInstance& sprite)
+{
+	find(texture.id).sprites.push_back(sprite);
+	count_++;
+}
+
+SpriteBatch::Batch& SpriteBatch::find(uint32_t texture)
+{
+	if (last_ < used_ && batches_[last_].texture == texture)
+		return batches_[last_];
+	// Few textures are drawn per frame, a scan beats hashing
+	for (size_t i = 0; i < used_; i++) {
+		if (batches_[i].texture == texture) {
+			last_ = i;
+			return batches_[i];
+		}
+	}
+	if (used_ == batches_.size())
+		batches_.emplace_back();
+	last_ = used_++;
+	auto& batch = batches_[last_];
+	batch.texture = texture;
+	return batch;
+}
+
+void SpriteBatch::record(vk::CommandBuffer cmd, FrameArena& arena, const GeometryStore& geometry,
+	const MeshHandle& quad, vk::PipelineLayout layout, glm::vec2 viewCenter) const
+{
+	if (count_ == 0)
+		return;
+	// The arena warns when it runs out, the sprites are skipped for the frame
+	const auto instances = arena.allocate(count_ * sizeof(SpriteInstance), alignof(SpriteInstance));
+	if (!instances)
+		return;
+
+	auto out = instances.data;
+	for (size_t i = 0; i < used_; i++) {
+		const auto& sprites = batches_[i].sprites;
+		std::memcpy(out, sprites.data(), sprites.size() * sizeof(SpriteInstance));
+		out += sprites.size() * sizeof(SpriteInstance);
+	}
+	cmd.bindVertexBuffers(VertexInput<SpriteInstance>::layout.binding.binding, instances.buffer, instances.offset);
+
+	uint32_t firstInstance = 0;
+	for (size_t i = 0; i < used_; i++) {
+		const auto& batch = batches_[i];
+		const QuadConstants constants {{viewCenter[0], viewCenter[1]}, batch.texture};
+		cmd.pushConstants(layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+			0, sizeof(constants), &constants);
+		const auto count = static_cast<uint32_t>(batch.sprites.size());
+		geometry.draw(cmd, quad, count, firstInstance);
+		firstInstance += count;
+	}
+}
+
+}
@@ -0,0 +1,66 @@
+//
+// Created by ocean on 4/5/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_SPRITEBATCH_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_SPRITEBATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "FrameArena.hpp"
+#include "GeometryStore.hpp"
+#include "TextureStreamer.hpp"
+#include "Vertex.hpp"
+
+namespace VulkanPlayground
+{
+
+/// Textured quads collected during a frame and drawn as instances of the quad
+/// mesh, with one instanced draw per texture.
+/// The instances of all batches are copied into the frame arena back to back,
+/// so they are bound once and each draw picks its range with firstInstance.
+/// Batches keep their memory across frames, refilling them allocates nothing.
+///
+/// Textures are told apart through the bindless table, without it every sprite
+/// shows the texture bound for the frame.
+class SpriteBatch
+{
+public:
+	/// Drop the sprites of the previous frame
+	void clear();
+	void add(TextureHandle texture, const SpriteInstance& sprite);
+
+	/// Copy the sprites into the arena and draw them.
+	/// The sprite pipeline, its descriptor sets and the geometry must be bound.
+	void record(vk::CommandBuffer cmd, FrameArena& arena, const GeometryStore& geometry, const MeshHandle& quad,
+		vk::PipelineLayout layout, glm::vec2 viewCenter) const;
+
+	size_t size() const { return count_; }
+	bool empty() const { return count_ == 0; }
+	/// Draws record() issues, one per texture
+	size_t batches() const { return used_; }
+
+private:
+	struct Batch
+	{
+		uint32_t texture;
+		std::vector<SpriteInstance> sprites;
+	};
+
+	Batch& find(uint32_t texture);
+
+	// The first used_ are this frame's, the others keep their capacity for later
+	std::vector<Batch> batches_;
+	size_t used_ = 0;
+	// Sprites come in runs of the same texture, try the last batch first
+	size_t last_ = 0;
+	size_t count_ = 0;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_SPRITEBATCH_HPP
@@ -0,0 +1,65 @@
+//
+// Created by ocean on 3/20/22.
+//
+
+#include "ThreadPool.hpp"
+
+namespace VulkanPlayground
+{
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	if (threads == 0) {
+		// hardware_concurrency() may be 0 when it cannot tell
+		const unsigned cores = std::thread::hardware_concurrency();
+		threads = cores > 1 ? cores - 1 : 1;
+	}
+	threads_.reserve(threads);
+	for (unsigned i = 0; i < threads; i++)
+		threads_.emplace_back(&ThreadPool::worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(mutex_);
+		stop_ = true;
+		jobs_.clear();
+		urgent_ = 0;
+	}
+	wake_.notify_all();
+	for (auto& thread : threads_)
+		thread.join();
+}
+
+void ThreadPool::post(std::function<void()> job, Priority priority)
+{
+	{
+		std::lock_guard lock(mutex_);
+		if (priority == Priority::Urgent)
+			jobs_.insert(jobs_.begin() + static_cast<ptrdiff_t>(urgent_++), std::move(job));
+		else
+			jobs_.push_back(std::move(job));
+	}
+	wake_.notify_one();
+}
+
+void ThreadPool::worker()
+{
+	std::unique_lock lock(mutex_);
+	while (true) {
+		wake_.wait(lock, [&] { return stop_ || !jobs_.empty(); });
+		if (stop_)
+			return;
+		auto job = std::move(jobs_.front());
+		jobs_.pop_front();
+		if (urgent_ > 0)
+			urgent_--;
+
+		lock.unlock();
+		job();
+		lock.lock();
+	}
+}
+
+}
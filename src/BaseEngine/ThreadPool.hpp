@@ -0,0 +1,71 @@
+//
+// Created by ocean on 3/20/22.
+//
+
+#ifndef VULKANPLAYGROUND_SRC_BASEENGINE_THREADPOOL_HPP
+#define VULKANPLAYGROUND_SRC_BASEENGINE_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace VulkanPlayground
+{
+
+/// Fixed set of worker threads shared by everything that loads or compiles
+/// in the background. Jobs run in submission order within their priority
+/// but may finish in any.
+class ThreadPool
+{
+public:
+	enum class Priority
+	{
+		Normal,
+		// Ahead of every queued normal job, for work something blocks on
+		Urgent,
+	};
+
+	/// 0 uses one thread per core, leaving one for the render thread
+	explicit ThreadPool(unsigned threads = 0);
+	/// Jobs still queued are dropped, running ones are waited for
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void post(std::function<void()> job, Priority priority = Priority::Normal);
+
+	template<typename F>
+	auto submit(F&& f, Priority priority = Priority::Normal) -> std::future<std::invoke_result_t<F>>
+	{
+		using R = std::invoke_result_t<F>;
+		// std::function needs a copyable target
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+		auto future = task->get_future();
+		post([task] { (*task)(); }, priority);
+		return future;
+	}
+
+	unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+private:
+	void worker();
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::deque<std::function<void()>> jobs_;
+	// Urgent jobs at the front of jobs_
+	size_t urgent_ = 0;
+	bool stop_ = false;
+	std::vector<std::thread> threads_;
+};
+
+}
+
+#endif //VULKANPLAYGROUND_SRC_BASEENGINE_THREADPOOL_HPP
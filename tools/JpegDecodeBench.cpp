@@ -0,0 +1,221 @@
+// Decode throughput of stb_image on a corpus of JPEGs with the SSE2 kernels
+// against the AVX2 ones, checking that both decode to the same pixels.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "stb_image.h"
+
+namespace
+{
+
+struct Options
+{
+	unsigned iterations = 5;
+	int channels = STBI_rgb_alpha;
+	const char* json = nullptr;
+	std::vector<std::string> inputs;
+};
+
+struct Image
+{
+	std::string path;
+	std::vector<unsigned char> file;
+	size_t pixels = 0;
+};
+
+struct Run
+{
+	double seconds;
+	double mbPerSecond;
+	double mpixelsPerSecond;
+};
+
+void usage(const char* argv0)
+{
+	std::fprintf(stderr,
+		"Usage: %s [options] FILE|DIR...\n"
+		"  --iterations N   decodes of the corpus per kernel set, the fastest counts (default 5)\n"
+		"  --channels N     components requested from stb, 3 or 4 (default 4, like the engine)\n"
+		"  --json PATH      write results as JSON\n",
+		argv0);
+}
+
+bool parse(int argc, char* argv[], Options& opt)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(arg, "--iterations") == 0 && hasValue) {
+			opt.iterations = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(arg, "--channels") == 0 && hasValue) {
+			opt.channels = std::atoi(argv[++i]);
+			if (opt.channels != 3 && opt.channels != 4)
+				return false;
+		} else if (std::strcmp(arg, "--json") == 0 && hasValue) {
+			opt.json = argv[++i];
+		} else if (arg[0] == '-') {
+			return false;
+		} else {
+			opt.inputs.emplace_back(arg);
+		}
+	}
+	return !opt.inputs.empty();
+}
+
+bool isJpeg(const std::filesystem::path& path)
+{
+	auto ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+	return ext == ".jpg" || ext == ".jpeg";
+}
+
+std::vector<Image> loadCorpus(const Options& opt)
+{
+	std::vector<std::string> paths;
+	for (const auto& input : opt.inputs) {
+		if (std::filesystem::is_directory(input)) {
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+				if (entry.is_regular_file() && isJpeg(entry.path()))
+					paths.push_back(entry.path().string());
+			}
+		} else {
+			paths.push_back(input);
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<Image> corpus;
+	for (auto& path : paths) {
+		std::ifstream file(path, std::ios::binary);
+		Image image {std::move(path), {std::istreambuf_iterator<char>(file), {}}};
+		int w, h, n;
+		if (!stbi_info_from_memory(image.file.data(), static_cast<int>(image.file.size()), &w, &h, &n)) {
+			spdlog::warn("Skipping {}: {}", image.path, stbi_failure_reason());
+			continue;
+		}
+		image.pixels = static_cast<size_t>(w) * h;
+		corpus.push_back(std::move(image));
+	}
+	return corpus;
+}
+
+unsigned char* decode(const Image& image, int channels)
+{
+	int w, h, n;
+	return stbi_load_from_memory(image.file.data(), static_cast<int>(image.file.size()), &w, &h, &n, channels);
+}
+
+Run measure(const std::vector<Image>& corpus, const Options& opt, size_t fileBytes, size_t pixels)
+{
+	using clock = std::chrono::steady_clock;
+	double best = 1e30;
+	for (unsigned i = 0; i < opt.iterations; i++) {
+		const auto start = clock::now();
+		for (const auto& image : corpus)
+			stbi_image_free(decode(image, opt.channels));
+		best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+	}
+	return {best, fileBytes / best / 1e6, pixels / best / 1e6};
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!parse(argc, argv, opt)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	const auto corpus = loadCorpus(opt);
+	if (corpus.empty()) {
+		spdlog::error("No decodable images given");
+		return 1;
+	}
+	size_t fileBytes = 0, pixels = 0;
+	for (const auto& image : corpus) {
+		fileBytes += image.file.size();
+		pixels += image.pixels;
+	}
+
+	stbi_set_jpeg_avx2(1);
+	const bool avx2 = stbi_jpeg_avx2_active();
+	if (!avx2)
+		spdlog::warn("AVX2 kernels are unavailable, both runs use the same kernels");
+
+	// Correctness first: both kernel sets must agree on every pixel
+	size_t mismatched = 0;
+	int maxDiff = 0;
+	for (const auto& image : corpus) {
+		stbi_set_jpeg_avx2(0);
+		const auto reference = decode(image, opt.channels);
+		stbi_set_jpeg_avx2(1);
+		const auto candidate = decode(image, opt.channels);
+		if (!reference || !candidate) {
+			spdlog::warn("{} failed to decode", image.path);
+		} else {
+			int diff = 0;
+			for (size_t i = 0; i < image.pixels * opt.channels; i++)
+				diff = std::max(diff, std::abs(reference[i] - candidate[i]));
+			if (diff) {
+				spdlog::error("{} differs by up to {}", image.path, diff);
+				mismatched++;
+				maxDiff = std::max(maxDiff, diff);
+			}
+		}
+		stbi_image_free(reference);
+		stbi_image_free(candidate);
+	}
+
+	stbi_set_jpeg_avx2(0);
+	const auto sse2 = measure(corpus, opt, fileBytes, pixels);
+	stbi_set_jpeg_avx2(1);
+	const auto wide = measure(corpus, opt, fileBytes, pixels);
+
+	spdlog::info("{} images, {:.1f} MB compressed, {:.1f} Mpixels, best of {}",
+		corpus.size(), fileBytes / 1e6, pixels / 1e6, opt.iterations);
+	spdlog::info("\tsse2  {:.3f}s  {:.1f} MB/s  {:.1f} Mpixels/s", sse2.seconds, sse2.mbPerSecond, sse2.mpixelsPerSecond);
+	spdlog::info("\tavx2  {:.3f}s  {:.1f} MB/s  {:.1f} Mpixels/s  ({:.2f}x)", wide.seconds, wide.mbPerSecond,
+		wide.mpixelsPerSecond, sse2.seconds / wide.seconds);
+	if (mismatched)
+		spdlog::error("{} images decode differently, by up to {}", mismatched, maxDiff);
+	else
+		spdlog::info("Output is bit-identical");
+
+	if (opt.json) {
+		const auto file = std::fopen(opt.json, "w");
+		if (!file) {
+			spdlog::error("Failed to open file: {}", opt.json);
+			return 1;
+		}
+		std::fprintf(file,
+			"{\n"
+			"  \"images\": %zu,\n"
+			"  \"compressed_bytes\": %zu,\n"
+			"  \"pixels\": %zu,\n"
+			"  \"avx2_available\": %s,\n"
+			"  \"sse2\": { \"seconds\": %.6f, \"mb_per_s\": %.3f, \"mpixels_per_s\": %.3f },\n"
+			"  \"avx2\": { \"seconds\": %.6f, \"mb_per_s\": %.3f, \"mpixels_per_s\": %.3f },\n"
+			"  \"mismatched_images\": %zu,\n"
+			"  \"max_abs_diff\": %d\n"
+			"}\n",
+			corpus.size(), fileBytes, pixels, avx2 ? "true" : "false",
+			sse2.seconds, sse2.mbPerSecond, sse2.mpixelsPerSecond,
+			wide.seconds, wide.mbPerSecond, wide.mpixelsPerSecond,
+			mismatched, maxDiff);
+		std::fclose(file);
+	}
+	return mismatched ? 1 : 0;
+}
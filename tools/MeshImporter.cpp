@@ -0,0 +1,718 @@
+// Offline mesh import: reads OBJ or binary glTF, reorders it for the
+// post-transform vertex cache, for overdraw and for vertex fetch, optionally
+// splits it into meshlets, and writes the MeshFile the engine maps in place.
+// Prints the vertex cache statistics before and after so the savings in
+// vertex shading can be compared across meshes.
+
+#include "MeshFile.hpp"
+#include "MeshOptimize.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+
+using namespace VulkanPlayground;
+
+struct Options
+{
+	const char* outDir = nullptr;
+	// 0 keeps the cache order
+	float overdrawThreshold = 1.05f;
+	bool meshlets = false;
+	uint32_t maxVertices = 64;
+	uint32_t maxTriangles = 124;
+	std::vector<std::string> inputs;
+};
+
+// Full precision until the mesh is written
+struct ImportVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+struct Mesh
+{
+	std::vector<ImportVertex> vertices;
+	std::vector<uint32_t> indices;
+	bool hasNormals = true;
+};
+
+void usage(const char* argv0)
+{
+	std::fprintf(stderr,
+		"Usage: %s [options] MESH...\n"
+		"  --out DIR             write into DIR instead of next to each mesh\n"
+		"  --overdraw T          let the cache get up to T times worse to cut\n"
+		"                        overdraw, 1.05 by default, 0 to skip\n"
+		"  --meshlets            also split into meshlets\n"
+		"  --max-vertices N      per meshlet, 64 by default, at most 256\n"
+		"  --max-triangles N     per meshlet, 124 by default\n"
+		"Reads .obj and .glb, the meshes of a glTF scene are merged in world space.\n"
+		"Writes NAME.vpmesh for every NAME.EXT given.\n",
+		argv0);
+}
+
+bool parse(int argc, char* argv[], Options& opt)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(arg, "--out") == 0 && hasValue) {
+			opt.outDir = argv[++i];
+		} else if (std::strcmp(arg, "--overdraw") == 0 && hasValue) {
+			opt.overdrawThreshold = std::strtof(argv[++i], nullptr);
+		} else if (std::strcmp(arg, "--meshlets") == 0) {
+			opt.meshlets = true;
+		} else if (std::strcmp(arg, "--max-vertices") == 0 && hasValue) {
+			opt.maxVertices = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(arg, "--max-triangles") == 0 && hasValue) {
+			opt.maxTriangles = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (arg[0] == '-') {
+			return false;
+		} else {
+			opt.inputs.emplace_back(arg);
+		}
+	}
+	return !opt.inputs.empty() && opt.maxVertices >= 3 && opt.maxVertices <= 256 && opt.maxTriangles > 0;
+}
+
+bool readFile(const std::string& path, std::vector<char>& data)
+{
+	const auto file = std::fopen(path.c_str(), "rb");
+	if (!file) {
+		spdlog::error("Failed to open file: {}", path);
+		return false;
+	}
+	std::fseek(file, 0, SEEK_END);
+	const auto size = static_cast<size_t>(std::ftell(file));
+	std::fseek(file, 0, SEEK_SET);
+	data.resize(size);
+	const auto readIn = std::fread(data.data(), 1, size, file);
+	std::fclose(file);
+	if (readIn != size) {
+		spdlog::error("Failed to read {}", path);
+		return false;
+	}
+	return true;
+}
+
+// OBJ
+
+struct ObjCorner
+{
+	int32_t position, uv, normal;
+
+	bool operator==(const ObjCorner&) const = default;
+};
+
+struct ObjCornerHash
+{
+	size_t operator()(const ObjCorner& c) const
+	{
+		return std::hash<uint64_t>()((uint64_t(uint32_t(c.position)) << 32) ^ (uint64_t(uint32_t(c.uv)) << 16)
+			^ uint32_t(c.normal));
+	}
+};
+
+// 1 based, or negative from the end of what has been read so far. -1 when absent.
+bool objIndex(const char*& p, size_t count, int32_t& index)
+{
+	char* end;
+	const auto value = std::strtol(p, &end, 10);
+	if (end == p)
+		return false;
+	p = end;
+	const auto resolved = value < 0 ? static_cast<long>(count) + value : value - 1;
+	if (value == 0 || resolved < 0 || resolved >= static_cast<long>(count))
+		return false;
+	index = static_cast<int32_t>(resolved);
+	return true;
+}
+
+bool loadObj(const std::string& path, Mesh& mesh)
+{
+	std::vector<char> text;
+	if (!readFile(path, text))
+		return false;
+	text.push_back('\n');
+
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> uvs;
+	std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> unique;
+	std::vector<uint32_t> polygon;
+
+	size_t lineNumber = 0;
+	for (char* line = text.data(); line < text.data() + text.size(); ) {
+		char* const end = static_cast<char *>(std::memchr(line, '\n', text.data() + text.size() - line));
+		// Numbers cannot run into the next line
+		*end = '\0';
+		lineNumber++;
+		const char* p = line;
+		line = end + 1;
+		while (*p == ' ' || *p == '\t')
+			p++;
+
+		if (std::strncmp(p, "v ", 2) == 0) {
+			glm::vec3 v {0.0f};
+			std::sscanf(p + 2, "%f %f %f", &v.x, &v.y, &v.z);
+			positions.push_back(v);
+		} else if (std::strncmp(p, "vt ", 3) == 0) {
+			glm::vec2 uv {0.0f};
+			std::sscanf(p + 3, "%f %f", &uv.x, &uv.y);
+			// OBJ puts the origin bottom left, Vulkan samples from the top left
+			uvs.emplace_back(uv.x, 1.0f - uv.y);
+		} else if (std::strncmp(p, "vn ", 3) == 0) {
+			glm::vec3 n {0.0f};
+			std::sscanf(p + 3, "%f %f %f", &n.x, &n.y, &n.z);
+			normals.push_back(n);
+		} else if (std::strncmp(p, "f ", 2) == 0) {
+			polygon.clear();
+			p += 2;
+			for (;;) {
+				while (*p == ' ' || *p == '\t' || *p == '\r')
+					p++;
+				if (*p == '\0')
+					break;
+				// v, v/vt, v//vn or v/vt/vn
+				ObjCorner corner {-1, -1, -1};
+				bool ok = objIndex(p, positions.size(), corner.position);
+				if (ok && *p == '/') {
+					p++;
+					if (*p != '/')
+						ok = objIndex(p, uvs.size(), corner.uv);
+					if (ok && *p == '/') {
+						p++;
+						ok = objIndex(p, normals.size(), corner.normal);
+					}
+				}
+				if (!ok) {
+					spdlog::error("{}:{}: bad face", path, lineNumber);
+					return false;
+				}
+
+				const auto [it, added] = unique.try_emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+				if (added) {
+					mesh.vertices.push_back({
+						.position = positions[corner.position],
+						.normal = corner.normal >= 0 ? normals[corner.normal] : glm::vec3(0.0f),
+						.uv = corner.uv >= 0 ? uvs[corner.uv] : glm::vec2(0.0f)
+					});
+					mesh.hasNormals &= corner.normal >= 0;
+				}
+				polygon.push_back(it->second);
+			}
+			// Polygons are assumed convex and fanned out from their first corner
+			for (size_t i = 2; i < polygon.size(); i++)
+				mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+		}
+	}
+	return true;
+}
+
+// Binary glTF, through a JSON reader covering what the header chunk holds
+
+struct Json
+{
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type type = Type::Null;
+	double number = 0.0;
+	std::string string;
+	std::vector<Json> items;
+	std::vector<std::pair<std::string, Json>> members;
+
+	const Json* find(std::string_view key) const
+	{
+		for (const auto& [name, value] : members) {
+			if (name == key)
+				return &value;
+		}
+		return nullptr;
+	}
+	double numberOr(std::string_view key, double fallback) const
+	{
+		const auto value = find(key);
+		return value && value->type == Type::Number ? value->number : fallback;
+	}
+	/// SIZE_MAX unless a number that can index an array
+	size_t index() const
+	{
+		return type == Type::Number && number >= 0.0 ? static_cast<size_t>(number) : SIZE_MAX;
+	}
+	size_t index(std::string_view key) const
+	{
+		const auto value = find(key);
+		return value ? value->index() : SIZE_MAX;
+	}
+	const Json* at(std::string_view key, size_t index) const
+	{
+		const auto array = find(key);
+		return array && index < array->items.size() ? &array->items[index] : nullptr;
+	}
+};
+
+class JsonReader
+{
+public:
+	JsonReader(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+	bool read(Json& value, int depth = 0)
+	{
+		skipSpace();
+		if (p_ == end_ || depth > 64)
+			return false;
+		if (*p_ == '{') {
+			value.type = Json::Type::Object;
+			p_++;
+			if (consume('}'))
+				return true;
+			do {
+				skipSpace();
+				auto& member = value.members.emplace_back();
+				if (!readString(member.first) || !consume(':') || !read(member.second, depth + 1))
+					return false;
+			} while (consume(','));
+			return consume('}');
+		}
+		if (*p_ == '[') {
+			value.type = Json::Type::Array;
+			p_++;
+			if (consume(']'))
+				return true;
+			do {
+				if (!read(value.items.emplace_back(), depth + 1))
+					return false;
+			} while (consume(','));
+			return consume(']');
+		}
+		if (*p_ == '"') {
+			value.type = Json::Type::String;
+			return readString(value.string);
+		}
+		if (literal("true")) {
+			value.type = Json::Type::Bool;
+			value.number = 1.0;
+			return true;
+		}
+		if (literal("false")) {
+			value.type = Json::Type::Bool;
+			return true;
+		}
+		if (literal("null"))
+			return true;
+
+		char* numberEnd;
+		value.type = Json::Type::Number;
+		value.number = std::strtod(p_, &numberEnd);
+		if (numberEnd == p_ || numberEnd > end_)
+			return false;
+		p_ = numberEnd;
+		return true;
+	}
+
+private:
+	void skipSpace()
+	{
+		while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+			p_++;
+	}
+	bool consume(char c)
+	{
+		skipSpace();
+		if (p_ == end_ || *p_ != c)
+			return false;
+		p_++;
+		return true;
+	}
+	bool literal(std::string_view word)
+	{
+		if (static_cast<size_t>(end_ - p_) < word.size() || std::string_view(p_, word.size()) != word)
+			return false;
+		p_ += word.size();
+		return true;
+	}
+	// Escapes are kept as their character, glTF only uses strings as names and URIs
+	bool readString(std::string& out)
+	{
+		if (p_ == end_ || *p_++ != '"')
+			return false;
+		while (p_ < end_ && *p_ != '"') {
+			if (*p_ == '\\' && ++p_ == end_)
+				return false;
+			out.push_back(*p_++);
+		}
+		return p_++ < end_;
+	}
+
+	const char* p_;
+	const char* end_;
+};
+
+constexpr uint32_t glbMagic = 0x46546C67;
+constexpr uint32_t glbJson = 0x4E4F534A;
+constexpr uint32_t glbBin = 0x004E4942;
+
+struct Gltf
+{
+	Json json;
+	std::span<const std::byte> bin;
+};
+
+// Elements of an accessor as floats, normalized integers are mapped to [0, 1] or [-1, 1]
+bool readAccessor(const Gltf& gltf, size_t index, size_t components, std::vector<float>& out)
+{
+	const auto accessor = gltf.json.at("accessors", index);
+	if (!accessor || accessor->find("sparse"))
+		return false;
+	const auto view = gltf.json.at("bufferViews", accessor->index("bufferView"));
+	if (!view || view->numberOr("buffer", 0) != 0)
+		return false;
+
+	static const std::unordered_map<std::string_view, size_t> typeComponents {
+		{"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4}
+	};
+	const auto type = accessor->find("type");
+	const auto typeIt = type ? typeComponents.find(type->string) : typeComponents.end();
+	if (typeIt == typeComponents.end() || typeIt->second < components)
+		return false;
+
+	const auto componentType = static_cast<uint32_t>(accessor->numberOr("componentType", 0));
+	size_t componentSize;
+	switch (componentType) {
+	case 5120: case 5121: componentSize = 1; break;
+	case 5122: case 5123: componentSize = 2; break;
+	case 5125: case 5126: componentSize = 4; break;
+	default: return false;
+	}
+	const auto normalizedValue = accessor->find("normalized");
+	const bool normalized = normalizedValue && normalizedValue->number != 0.0;
+
+	const auto count = static_cast<size_t>(accessor->numberOr("count", 0));
+	const auto elementSize = componentSize * typeIt->second;
+	const auto stride = static_cast<size_t>(view->numberOr("byteStride", static_cast<double>(elementSize)));
+	const auto begin = static_cast<size_t>(view->numberOr("byteOffset", 0) + accessor->numberOr("byteOffset", 0));
+	const auto viewEnd = static_cast<size_t>(view->numberOr("byteOffset", 0) + view->numberOr("byteLength", 0));
+	if (count == 0 || stride < elementSize || viewEnd > gltf.bin.size()
+		|| begin + stride * (count - 1) + elementSize > viewEnd)
+		return false;
+
+	out.resize(count * components);
+	for (size_t i = 0; i < count; i++) {
+		const auto element = gltf.bin.data() + begin + stride * i;
+		for (size_t c = 0; c < components; c++) {
+			const auto at = element + componentSize * c;
+			float value;
+			switch (componentType) {
+			case 5120: { int8_t v; std::memcpy(&v, at, 1); value = normalized ? std::max(v / 127.0f, -1.0f) : v; break; }
+			case 5121: { uint8_t v; std::memcpy(&v, at, 1); value = normalized ? v / 255.0f : v; break; }
+			case 5122: { int16_t v; std::memcpy(&v, at, 2); value = normalized ? std::max(v / 32767.0f, -1.0f) : v; break; }
+			case 5123: { uint16_t v; std::memcpy(&v, at, 2); value = normalized ? v / 65535.0f : v; break; }
+			case 5125: { uint32_t v; std::memcpy(&v, at, 4); value = static_cast<float>(v); break; }
+			default: std::memcpy(&value, at, 4); break;
+			}
+			out[i * components + c] = value;
+		}
+	}
+	return true;
+}
+
+bool readIndices(const Gltf& gltf, size_t index, std::vector<uint32_t>& out)
+{
+	// Exact up to 2^24 vertices, past what the geometry store holds
+	std::vector<float> values;
+	if (!readAccessor(gltf, index, 1, values))
+		return false;
+	out.resize(values.size());
+	for (size_t i = 0; i < values.size(); i++)
+		out[i] = static_cast<uint32_t>(values[i]);
+	return true;
+}
+
+bool loadPrimitive(const Gltf& gltf, const Json& primitive, const glm::mat4& transform, Mesh& mesh)
+{
+	// Triangle lists only
+	if (primitive.numberOr("mode", 4) != 4)
+		return true;
+	const auto attributes = primitive.find("attributes");
+	if (!attributes || !attributes->find("POSITION"))
+		return false;
+
+	std::vector<float> positions, normals, uvs;
+	if (!readAccessor(gltf, attributes->index("POSITION"), 3, positions))
+		return false;
+	const auto count = positions.size() / 3;
+	if (attributes->find("NORMAL")
+		&& (!readAccessor(gltf, attributes->index("NORMAL"), 3, normals)
+			|| normals.size() != count * 3))
+		return false;
+	if (attributes->find("TEXCOORD_0")
+		&& (!readAccessor(gltf, attributes->index("TEXCOORD_0"), 2, uvs)
+			|| uvs.size() != count * 2))
+		return false;
+
+	std::vector<uint32_t> indices;
+	if (primitive.find("indices")) {
+		if (!readIndices(gltf, primitive.index("indices"), indices))
+			return false;
+	} else {
+		indices.resize(count);
+		for (size_t i = 0; i < count; i++)
+			indices[i] = static_cast<uint32_t>(i);
+	}
+
+	const auto normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+	const auto first = static_cast<uint32_t>(mesh.vertices.size());
+	for (size_t i = 0; i < count; i++) {
+		const glm::vec3 position {positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]};
+		ImportVertex vertex {
+			.position = glm::vec3(transform * glm::vec4(position, 1.0f)),
+			.normal = glm::vec3(0.0f),
+			.uv = uvs.empty() ? glm::vec2(0.0f) : glm::vec2(uvs[i * 2], uvs[i * 2 + 1])
+		};
+		if (!normals.empty())
+			vertex.normal = glm::normalize(normalTransform * glm::vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]));
+		mesh.vertices.push_back(vertex);
+	}
+	mesh.hasNormals &= !normals.empty();
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		if (indices[i] >= count || indices[i + 1] >= count || indices[i + 2] >= count)
+			return false;
+		mesh.indices.insert(mesh.indices.end(), {first + indices[i], first + indices[i + 1], first + indices[i + 2]});
+	}
+	return true;
+}
+
+glm::mat4 nodeTransform(const Json& node)
+{
+	glm::mat4 m {1.0f};
+	if (const auto matrix = node.find("matrix"); matrix && matrix->items.size() == 16) {
+		// Column major, as glm
+		for (size_t i = 0; i < 16; i++)
+			m[static_cast<int>(i / 4)][static_cast<int>(i % 4)] = static_cast<float>(matrix->items[i].number);
+		return m;
+	}
+	const auto vec = [&](const char* key, size_t i, float fallback) {
+		const auto value = node.at(key, i);
+		return value ? static_cast<float>(value->number) : fallback;
+	};
+	m = glm::translate(m, {vec("translation", 0, 0.0f), vec("translation", 1, 0.0f), vec("translation", 2, 0.0f)});
+	m *= glm::mat4_cast(glm::quat(vec("rotation", 3, 1.0f), vec("rotation", 0, 0.0f), vec("rotation", 1, 0.0f),
+		vec("rotation", 2, 0.0f)));
+	return glm::scale(m, {vec("scale", 0, 1.0f), vec("scale", 1, 1.0f), vec("scale", 2, 1.0f)});
+}
+
+bool loadNode(const Gltf& gltf, size_t index, const glm::mat4& parent, Mesh& mesh, int depth)
+{
+	const auto node = gltf.json.at("nodes", index);
+	if (!node || depth > 64)
+		return false;
+	const auto transform = parent * nodeTransform(*node);
+	if (node->find("mesh")) {
+		const auto gltfMesh = gltf.json.at("meshes", node->index("mesh"));
+		const auto primitives = gltfMesh ? gltfMesh->find("primitives") : nullptr;
+		if (!primitives)
+			return false;
+		for (const auto& primitive : primitives->items) {
+			if (!loadPrimitive(gltf, primitive, transform, mesh))
+				return false;
+		}
+	}
+	if (const auto children = node->find("children")) {
+		for (const auto& child : children->items) {
+			if (!loadNode(gltf, child.index(), transform, mesh, depth + 1))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool loadGlb(const std::string& path, Mesh& mesh)
+{
+	std::vector<char> file;
+	if (!readFile(path, file))
+		return false;
+	const auto word = [&](size_t offset) {
+		uint32_t value = 0;
+		if (offset + 4 <= file.size())
+			std::memcpy(&value, file.data() + offset, 4);
+		return value;
+	};
+	if (word(0) != glbMagic || word(4) != 2 || word(8) > file.size() || word(16) != glbJson) {
+		spdlog::error("{} is not binary glTF 2.0", path);
+		return false;
+	}
+
+	Gltf gltf;
+	const size_t jsonSize = word(12);
+	const size_t binOffset = 20 + jsonSize;
+	JsonReader reader(file.data() + 20, file.data() + std::min(binOffset, file.size()));
+	if (binOffset > file.size() || !reader.read(gltf.json) || gltf.json.type != Json::Type::Object) {
+		spdlog::error("{}: malformed glTF JSON", path);
+		return false;
+	}
+	if (word(binOffset + 4) == glbBin && binOffset + 8 + word(binOffset) <= file.size())
+		gltf.bin = std::as_bytes(std::span(file)).subspan(binOffset + 8, word(binOffset));
+
+	bool ok = true;
+	const auto scene = gltf.json.at("scenes", gltf.json.find("scene") ? gltf.json.index("scene") : 0);
+	const auto roots = scene ? scene->find("nodes") : nullptr;
+	if (roots) {
+		for (const auto& root : roots->items)
+			ok = ok && loadNode(gltf, root.index(), glm::mat4(1.0f), mesh, 0);
+	} else if (const auto meshes = gltf.json.find("meshes")) {
+		// No scene, every mesh where it was modeled
+		for (const auto& gltfMesh : meshes->items) {
+			const auto primitives = gltfMesh.find("primitives");
+			for (size_t i = 0; ok && primitives && i < primitives->items.size(); i++)
+				ok = loadPrimitive(gltf, primitives->items[i], glm::mat4(1.0f), mesh);
+		}
+	}
+	if (!ok)
+		spdlog::error("{}: unsupported or malformed mesh data", path);
+	return ok;
+}
+
+// Area weighted, shared by every vertex at the same position so seams in the
+// texture coordinates stay smooth
+void generateNormals(Mesh& mesh)
+{
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			// -0 and 0 compare equal, they must hash the same
+			const auto positive = p + glm::vec3(0.0f);
+			uint32_t bits[3];
+			std::memcpy(bits, &positive, sizeof(bits));
+			return std::hash<uint64_t>()((uint64_t(bits[0]) << 32 | bits[1]) ^ (uint64_t(bits[2]) << 16));
+		}
+	};
+	std::unordered_map<glm::vec3, glm::vec3, PositionHash> sums;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		const auto& a = mesh.vertices[mesh.indices[i]].position;
+		const auto& b = mesh.vertices[mesh.indices[i + 1]].position;
+		const auto& c = mesh.vertices[mesh.indices[i + 2]].position;
+		const auto normal = glm::cross(b - a, c - a);
+		for (const auto& p : {a, b, c})
+			sums[p] += normal;
+	}
+	for (auto& vertex : mesh.vertices) {
+		const auto sum = sums[vertex.position];
+		const auto length = glm::length(sum);
+		vertex.normal = length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+}
+
+std::filesystem::path outputPath(const Options& opt, const std::filesystem::path& input)
+{
+	auto output = opt.outDir ? std::filesystem::path(opt.outDir) / input.filename() : input;
+	output.replace_extension(".vpmesh");
+	return output;
+}
+
+bool import(const Options& opt, const std::string& input)
+{
+	const auto start = std::chrono::steady_clock::now();
+	Mesh mesh;
+	const auto extension = std::filesystem::path(input).extension().string();
+	bool loaded;
+	if (extension == ".obj" || extension == ".OBJ") {
+		loaded = loadObj(input, mesh);
+	} else if (extension == ".glb" || extension == ".GLB") {
+		loaded = loadGlb(input, mesh);
+	} else {
+		spdlog::error("{}: only .obj and .glb are read", input);
+		return false;
+	}
+	if (!loaded)
+		return false;
+	if (mesh.indices.empty()) {
+		spdlog::error("{} has no triangles", input);
+		return false;
+	}
+	if (!mesh.hasNormals)
+		generateNormals(mesh);
+
+	const auto before = MeshOptimize::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+	MeshOptimize::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	if (opt.overdrawThreshold > 0.0f) {
+		std::vector<glm::vec3> positions(mesh.vertices.size());
+		for (size_t i = 0; i < positions.size(); i++)
+			positions[i] = mesh.vertices[i].position;
+		MeshOptimize::optimizeOverdraw(mesh.indices, positions, opt.overdrawThreshold);
+	}
+	const auto remap = MeshOptimize::optimizeVertexFetch(mesh.indices, mesh.vertices.size());
+	mesh.vertices = MeshOptimize::remapVertices<ImportVertex>(mesh.vertices, remap);
+	const auto after = MeshOptimize::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+	MeshOptimize::Meshlets meshlets;
+	if (opt.meshlets)
+		meshlets = MeshOptimize::buildMeshlets(mesh.indices, mesh.vertices.size(), opt.maxVertices, opt.maxTriangles);
+
+	std::vector<MeshVertex> packed(mesh.vertices.size());
+	for (size_t i = 0; i < packed.size(); i++) {
+		const auto& vertex = mesh.vertices[i];
+		packed[i] = {
+			.position = vertex.position,
+			.normal = packSnorm1010102(glm::vec4(vertex.normal, 0.0f)),
+			.uv = packHalf2(vertex.uv)
+		};
+	}
+
+	std::error_code error;
+	if (opt.outDir)
+		std::filesystem::create_directories(opt.outDir, error);
+	const auto output = outputPath(opt, input);
+	const MeshFile::Contents contents {
+		.vertices = packed,
+		.indices = mesh.indices,
+		.meshlets = meshlets.meshlets,
+		.meshletVertices = meshlets.vertices,
+		.meshletTriangles = meshlets.triangles
+	};
+	if (!MeshFile::write(output.string().c_str(), contents))
+		return false;
+
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	spdlog::info("{} -> {}: {} vertices, {} triangles{}, {:.1f} ms", input, output.string(), mesh.vertices.size(),
+		mesh.indices.size() / 3,
+		opt.meshlets ? fmt::format(", {} meshlets", meshlets.meshlets.size()) : std::string(), elapsed.count());
+	spdlog::info("  ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f} ({} entry FIFO)", before.acmr, after.acmr,
+		before.atvr, after.atvr, MeshOptimize::cacheSize);
+	return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!parse(argc, argv, opt)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	size_t failed = 0;
+	for (const auto& input : opt.inputs)
+		failed += !import(opt, input);
+	spdlog::info("Imported {} meshes, {} failed", opt.inputs.size() - failed, failed);
+	return failed ? 1 : 0;
+}
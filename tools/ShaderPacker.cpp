@@ -0,0 +1,94 @@
+// Packs compiled SPIR-V modules into the single shader pack the engine maps
+// at startup. Each module is named after its file without the .spv
+// extension, so trig.vert.spv is found as "trig.vert".
+
+#include "ShaderPack.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+
+using namespace VulkanPlayground;
+
+struct Options
+{
+	const char* out = nullptr;
+	std::vector<std::string> inputs;
+};
+
+void usage(const char* argv0)
+{
+	std::fprintf(stderr,
+		"Usage: %s --out PACK SPV...\n"
+		"  --out PACK    the shader pack to write\n",
+		argv0);
+}
+
+bool parse(int argc, char* argv[], Options& opt)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(arg, "--out") == 0 && hasValue) {
+			opt.out = argv[++i];
+		} else if (arg[0] == '-') {
+			return false;
+		} else {
+			opt.inputs.emplace_back(arg);
+		}
+	}
+	return opt.out && !opt.inputs.empty();
+}
+
+bool read(const std::string& path, std::vector<uint32_t>& code)
+{
+	const auto file = std::fopen(path.c_str(), "rb");
+	if (!file) {
+		spdlog::error("Failed to open file: {}", path);
+		return false;
+	}
+	std::fseek(file, 0, SEEK_END);
+	const auto size = static_cast<size_t>(std::ftell(file));
+	std::fseek(file, 0, SEEK_SET);
+	code.resize(size / sizeof(uint32_t));
+	const auto readIn = std::fread(code.data(), 1, size, file);
+	std::fclose(file);
+	if (size % sizeof(uint32_t) || readIn != size) {
+		spdlog::error("Failed to read SPIR-V from {}", path);
+		return false;
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!parse(argc, argv, opt)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<ShaderPack::Module> modules(opt.inputs.size());
+	size_t bytes = 0;
+	for (size_t i = 0; i < opt.inputs.size(); i++) {
+		const std::filesystem::path input = opt.inputs[i];
+		modules[i].name = input.extension() == ".spv" ? input.stem().string() : input.filename().string();
+		if (!read(opt.inputs[i], modules[i].code))
+			return 1;
+		bytes += modules[i].code.size() * sizeof(uint32_t);
+	}
+
+	if (!ShaderPack::write(opt.out, std::move(modules)))
+		return 1;
+	spdlog::info("Packed {} shaders, {:.1f} KiB of SPIR-V, into {}", opt.inputs.size(), bytes / 1024.0, opt.out);
+	return 0;
+}
@@ -0,0 +1,194 @@
+// Offline texture cooking: decodes images, builds their mip chain and writes
+// it block compressed into a KTX2 file next to the source, which the
+// TextureStreamer picks up in place of the original.
+
+#include "BlockCompress.hpp"
+#include "Ktx2.hpp"
+#include "Mipmaps.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "stb_image.h"
+
+namespace
+{
+
+using namespace VulkanPlayground;
+
+struct Codec
+{
+	const char* name;
+	vk::Format format;
+	uint32_t blockBytes;
+	void (*encode)(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out);
+};
+
+constexpr Codec codecs[] = {
+	{"bc7", vk::Format::eBc7SrgbBlock, 16, BlockCompress::encodeBc7},
+	{"bc1", vk::Format::eBc1RgbSrgbBlock, 8, BlockCompress::encodeBc1},
+};
+
+struct Options
+{
+	const Codec* codec = &codecs[0];
+	bool mipmaps = true;
+	const char* outDir = nullptr;
+	bool force = false;
+	std::vector<std::string> inputs;
+};
+
+struct Result
+{
+	bool ok = false;
+	bool skipped = false;
+	size_t rawBytes = 0;
+	size_t cookedBytes = 0;
+};
+
+void usage(const char* argv0)
+{
+	std::fprintf(stderr,
+		"Usage: %s [options] IMAGE...\n"
+		"  --format F    bc7 (default) or bc1\n"
+		"  --no-mips     only the base level\n"
+		"  --out DIR     write into DIR instead of next to each image\n"
+		"  --force       cook even when the output is newer than the image\n"
+		"Writes NAME.F.ktx2 for every NAME.EXT given.\n",
+		argv0);
+}
+
+bool parse(int argc, char* argv[], Options& opt)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(arg, "--format") == 0 && hasValue) {
+			const char* name = argv[++i];
+			const auto codec = std::find_if(std::begin(codecs), std::end(codecs),
+				[&](const Codec& c) { return std::strcmp(c.name, name) == 0; });
+			if (codec == std::end(codecs))
+				return false;
+			opt.codec = codec;
+		} else if (std::strcmp(arg, "--no-mips") == 0) {
+			opt.mipmaps = false;
+		} else if (std::strcmp(arg, "--out") == 0 && hasValue) {
+			opt.outDir = argv[++i];
+		} else if (std::strcmp(arg, "--force") == 0) {
+			opt.force = true;
+		} else if (arg[0] == '-') {
+			return false;
+		} else {
+			opt.inputs.emplace_back(arg);
+		}
+	}
+	return !opt.inputs.empty();
+}
+
+std::filesystem::path outputPath(const Options& opt, const std::filesystem::path& input)
+{
+	auto output = opt.outDir ? std::filesystem::path(opt.outDir) / input.filename() : input;
+	output.replace_extension(std::string(".") + opt.codec->name + ".ktx2");
+	return output;
+}
+
+Result cook(const Options& opt, const std::string& input)
+{
+	namespace fs = std::filesystem;
+	Result result;
+	const auto output = outputPath(opt, input);
+
+	std::error_code error;
+	if (!opt.force && fs::exists(output, error)
+		&& fs::last_write_time(output, error) >= fs::last_write_time(input, error) && !error) {
+		result.ok = result.skipped = true;
+		return result;
+	}
+
+	int w, h, n;
+	const auto img = stbi_load(input.c_str(), &w, &h, &n, STBI_rgb_alpha);
+	if (!img) {
+		spdlog::error("Failed to load image {}: {}", input, stbi_failure_reason());
+		return result;
+	}
+	const auto width = static_cast<uint32_t>(w);
+	const auto height = static_cast<uint32_t>(h);
+	const uint32_t levels = opt.mipmaps ? mipLevelCount(width, height) : 1;
+
+	result.rawBytes = mipChainBytes(width, height, levels);
+	const auto chain = static_cast<uint8_t *>(std::realloc(img, result.rawBytes));
+	if (!chain) {
+		spdlog::error("Out of memory for the mip chain of {}", input);
+		stbi_image_free(img);
+		return result;
+	}
+	generateMipChain(chain, width, height, levels);
+
+	std::vector<std::vector<uint8_t>> encoded(levels);
+	const uint8_t* level = chain;
+	for (uint32_t i = 0; i < levels; i++) {
+		const auto lw = std::max(1u, width >> i);
+		const auto lh = std::max(1u, height >> i);
+		encoded[i].resize(BlockCompress::encodedBytes(lw, lh, opt.codec->blockBytes));
+		opt.codec->encode(level, lw, lh, encoded[i].data());
+		level += size_t {lw} * lh * 4;
+		result.cookedBytes += encoded[i].size();
+	}
+	stbi_image_free(chain);
+
+	if (opt.outDir)
+		fs::create_directories(opt.outDir, error);
+	result.ok = Ktx2Texture::write(output.string().c_str(), opt.codec->format, width, height, encoded);
+	return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Options opt;
+	if (!parse(argc, argv, opt)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	// Nothing renders here, every core can encode
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::future<Result>> results;
+	results.reserve(opt.inputs.size());
+	for (const auto& input : opt.inputs)
+		results.push_back(pool.submit([&opt, &input] { return cook(opt, input); }));
+
+	size_t failed = 0, skipped = 0, rawBytes = 0, cookedBytes = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		const auto result = results[i].get();
+		if (!result.ok) {
+			failed++;
+		} else if (result.skipped) {
+			skipped++;
+		} else {
+			rawBytes += result.rawBytes;
+			cookedBytes += result.cookedBytes;
+			spdlog::info("{} -> {} ({:.1f} MiB -> {:.1f} MiB)", opt.inputs[i],
+				outputPath(opt, opt.inputs[i]).string(), result.rawBytes / 1048576.0, result.cookedBytes / 1048576.0);
+		}
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	spdlog::info("Cooked {} {} textures in {:.2f}s, {} up to date, {} failed, {:.1f}:1",
+		opt.inputs.size() - failed - skipped, opt.codec->name, elapsed.count(), skipped, failed,
+		cookedBytes ? static_cast<double>(rawBytes) / cookedBytes : 0.0);
+	return failed ? 1 : 0;
+}